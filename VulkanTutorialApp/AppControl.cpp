@@ -4,11 +4,15 @@
 #include "VTA_camera.h"
 #include "keyboard_movement_controller.h"
 #include "point_light_system.h"
+#include "indirect_render_system.h"
 #include "VTA_Buffer.h"
 #include "VTA_image.h"
+#include "VTA_mipgen.h"
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <chrono>
+#include <iostream>
 #include <numeric>
 
 #define GLM_FORCE_RADIANS
@@ -42,9 +46,6 @@ namespace VTA
 		ZoneScoped;
 		
 
-		descriptorAllocators = std::vector<VTADescriptorAllocatorGrowable>(VTASwapChain::MAX_FRAMES_IN_FLIGHT);
-
-
 		auto minOffsetAllignment = std::lcm(device.properties.limits.minUniformBufferOffsetAlignment, device.properties.limits.nonCoherentAtomSize);
 
 		VTABuffer globalUboBuffer{ device, sizeof(GlobalUbo), VTASwapChain::MAX_FRAMES_IN_FLIGHT,  // how many uniform buffer objects in our uniform buffer? one for each frame in flight
@@ -57,67 +58,129 @@ namespace VTA
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
 			.build();
 
-		auto textureSetLayout = VTADescriptorSetLayout::Builder(device)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
-
 		// setting up tracy for Vulkan
 		auto cmd = device.beginSingleTimeCommands();
 		auto tracyVkCtx = TracyVkContext(device.physicalDevice, device.device(), device.graphicsQueue(), cmd);
 		device.endSingleTimeCommands(cmd);
 		
-		for (int i = 0; i < descriptorAllocators.size(); i++)
+		std::vector<VTADescriptorAllocatorGrowable::PoolSizeRatio> cacheSizes = {
+				{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+				{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }, // SimpleRenderSystem's instance set
+		};
+		VTADescriptorCache descriptorCache{ device, cacheSizes, VTASwapChain::MAX_FRAMES_IN_FLIGHT };
+		VTAFrameDescriptorAllocator frameDescriptors{ device, VTASwapChain::MAX_FRAMES_IN_FLIGHT, 64, cacheSizes }; // sets that only live for one frame
+
+		for (int i = 0; i < VTASwapChain::MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			std::vector < VTADescriptorAllocatorGrowable::PoolSizeRatio> frame_sizes = {
-					{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
-					{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
-					{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
-					{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
-			};
-
-
-			descriptorAllocators[i] = VTADescriptorAllocatorGrowable{};
-			descriptorAllocators[i].init(device.device(), 1000, frame_sizes);
-			
-			auto bufferInfo = globalUboBuffer.descriptorInfo(); // get the descriptor info for the uniform buffer
-			auto testTextureInfo = testTexture.descriptorInfo();
-			auto mipmapTextureInfo = mipmapTexture.descriptorInfo();
-
-
-			VkDescriptorSet globalDescriptorSet = descriptorAllocators[i].allocate( // allocate a descriptor set from the descriptor allocator
-				device.device(),
-				globalSetLayout->getDescriptorSetLayout()
-			);
-
-			VkDescriptorSet testTextureDescriptorSet = descriptorAllocators[i].allocate(
-				device.device(),
-				textureSetLayout->getDescriptorSetLayout()
-			);
-
-			VkDescriptorSet mipmapTextureDescriptorSet = descriptorAllocators[i].allocate(
-				device.device(),
-				textureSetLayout->getDescriptorSetLayout()
-			);
-
-			VTADescriptorWriter globalSetWriter{ *globalSetLayout };
-			globalSetWriter.writeBuffer(0, &bufferInfo); // write to the writes vector
-			globalSetWriter.overwrite(globalDescriptorSet, device); // bind descriptor sets to the buffers in the writes vector
+			auto bufferInfo = globalUboBuffer.descriptorInfoForIndex(i); // each frame reads the slot writeToIndex fills for it
 
-			VTADescriptorWriter testTextureSetWriter{ *textureSetLayout };
-			testTextureSetWriter.writeImage(0, &testTextureInfo);
-			testTextureSetWriter.overwrite(testTextureDescriptorSet, device);
+			// textures aren't bound from here, the render systems bind them the way their texturing mode needs
+			descriptorSets.push_back({
+				descriptorCache.get(VTADescriptorCache::Request{ *globalSetLayout }.buffer(0, bufferInfo)) });
+		}
 
-			VTADescriptorWriter mipmapTextureSetWriter{ *textureSetLayout };
-			mipmapTextureSetWriter.writeImage(0, &mipmapTextureInfo);
-			mipmapTextureSetWriter.overwrite(mipmapTextureDescriptorSet, device);
+		// textureDSindex - 1 picks one of TEXTURE_FILES. With bindless every file becomes an image of its own and gets
+		// a slot in the array. Without it, files small enough share the atlas and aren't created as images at all, the
+		// rest become images that the classic render system pushes per draw
+		std::vector<uint32_t> bindlessIndices(TEXTURE_FILES.size());
+		std::vector<uint32_t> atlasHandles(TEXTURE_FILES.size());
+		std::vector<bool> inAtlas(TEXTURE_FILES.size(), false);
+		if (VTABindlessTextures::isSupported(device))
+		{
+			bindlessTextures = std::make_unique<VTABindlessTextures>(device);
+		}
+		for (size_t i = 0; i < TEXTURE_FILES.size(); i++)
+		{
+			if (!bindlessTextures && VTA_Image::TextureAtlas::fits(TEXTURE_FILES[i]))
+			{
+				if (!textureAtlas) textureAtlas = std::make_unique<VTA_Image::TextureAtlas>(device, 2048, &threadPool);
+				atlasHandles[i] = textureAtlas->add(TEXTURE_FILES[i]);
+				inAtlas[i] = true;
+				textures.emplace_back();
+				continue;
+			}
+			textures.push_back(std::make_unique<VTA_Image::Texture>(device, TEXTURE_FILES[i], VTA_Image::TextureUsage::Color, &mipDownsampler, &threadPool));
+			if (bindlessTextures) bindlessIndices[i] = bindlessTextures->registerTexture(*textures.back());
+		}
+		if (textureAtlas) textureAtlas->build();
 
+		bool anyAtlasModel = false;
+		bool anyClassicModel = false;
+		for (auto& kv : gameObjects)
+		{
+			auto& model = kv.second.model;
+			if (model == nullptr) continue;
+			size_t texture = static_cast<size_t>(model->textureDSindex - 1);
+			model->inAtlas = inAtlas[texture];
+			if (model->inAtlas)
+			{
+				model->atlasRegion = textureAtlas->getRegion(atlasHandles[texture]);
+				anyAtlasModel = true;
+				continue;
+			}
+			model->bindlessTextureIndex = bindlessIndices[texture];
+			model->textureInfo = textures[texture]->descriptorInfo();
+			anyClassicModel = true;
+		}
 
+		// the scene's lights are fixed after loading, the shader only has to loop over that many
+		SimpleRenderSystem::ShaderVariant shaderVariant{};
+		shaderVariant.maxLights = static_cast<uint32_t>(std::count_if(gameObjects.begin(), gameObjects.end(), [](const auto& kv) {
+			return kv.second.pointLight != nullptr;
+			}));
+
+		// either the indirect system draws the game objects, or the simple one does with bindless textures, or an atlas
+		// and a classic one split them by where their texture is. Systems with nothing to draw aren't created, so
+		// their pipelines aren't compiled
+		std::unique_ptr<IndirectRenderSystem> indirectRenderSystem;
+		std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
+		std::unique_ptr<SimpleRenderSystem> atlasRenderSystem;
+		if (GPU_DRIVEN && bindlessTextures && IndirectRenderSystem::isSupported(device))
+		{
+			indirectRenderSystem = std::make_unique<IndirectRenderSystem>(device, pipelineCompiler, renderer.getSwapChainRenderTarget(),
+				globalSetLayout->getDescriptorSetLayout(), *bindlessTextures, shaderVariant.maxLights);
+			indirectRenderSystem->setObjects(gameObjects);
+		}
+		else
+		{
+			if (anyClassicModel)
+			{
+				simpleRenderSystem = std::make_unique<SimpleRenderSystem>(device, pipelineCompiler, renderer.getSwapChainRenderTarget(), globalSetLayout->getDescriptorSetLayout(),
+					bindlessTextures.get(), nullptr, shaderVariant, &threadPool); // create the render system with the device and the swap chain render target
+			}
+			if (anyAtlasModel)
+			{
+				atlasRenderSystem = std::make_unique<SimpleRenderSystem>(device, pipelineCompiler, renderer.getSwapChainRenderTarget(), globalSetLayout->getDescriptorSetLayout(),
+					nullptr, textureAtlas.get(), shaderVariant, &threadPool);
+			}
+		}
+		PointLightSystem pointLightSystemSystem{ device, pipelineCompiler, renderer.getSwapChainRenderTarget(), globalSetLayout->getDescriptorSetLayout() }; // create the render system with the device and the swap chain render target
 
-			descriptorSets.push_back({ globalDescriptorSet, testTextureDescriptorSet, mipmapTextureDescriptorSet });
+		if (BENCHMARK_MIPGEN)
+		{
+			// the 4K texture, decoded again as RGBA8 since the resident one may have fewer channels
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load(TEXTURE_FILES[0], &width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels)
+			{
+				throw std::runtime_error("failed to load the mip benchmark texture!");
+			}
+			bool boxMatches = VTA_Image::MipGenerator::benchmark(pixels, width, height, VTA_Image::MipFilter::Box, &threadPool);
+			bool kaiserMatches = VTA_Image::MipGenerator::benchmark(pixels, width, height, VTA_Image::MipFilter::Kaiser, &threadPool);
+			stbi_image_free(pixels);
+			if (!boxMatches || !kaiserMatches)
+			{
+				throw std::runtime_error("SIMD mip chain doesn't match the scalar reference!");
+			}
 		}
 
-		SimpleRenderSystem simpleRenderSystem{ device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), textureSetLayout->getDescriptorSetLayout()}; // create the render system with the device and the swap chain render pass
-		PointLightSystem pointLightSystemSystem{ device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() }; // create the render system with the device and the swap chain render pass
+		if (BENCHMARK_DRAW_SORT)
+		{
+			auto result = VTADrawList::benchmark(threadPool);
+			std::cout << "draw sort of " << result.itemCount << " keys: std::stable_sort " << result.stdSortMs
+				<< " ms, radix sort " << result.radixSortMs << " ms, parallel radix sort " << result.parallelRadixSortMs << " ms\n";
+		}
 
         VTACamera camera{};
         //camera.setViewDirection(glm::vec3(0.f), glm::vec3(0.5f, 0.f, 1.f));
@@ -128,6 +191,7 @@ namespace VTA
         
         camera.setViewTarget(glm::vec3(-1.f, -2.f, 2.f), glm::vec3(0.f, 0.f, 5.f));
         auto currentTime = std::chrono::high_resolution_clock::now();
+		VTAFrameGraph::Stats frameGraphStats{};
 
 
 
@@ -152,6 +216,13 @@ namespace VTA
 			{
 				TracyVkZone(tracyVkCtx, commandBuffer, "GBuffer");
 				int frameIndex = renderer.getFrameIndex(); // get the current frame index
+				descriptorCache.nextFrame(); // beginFrame waited on this frame's fence
+				pipelineCompiler.applyReloads(); // recompiled shaders take effect from this frame on
+				frameDescriptors.beginFrame(frameIndex);
+				if (PARALLEL_RECORDING)
+				{
+					parallelRecorder.beginFrame(frameIndex, renderer.getSecondaryPassInfo());
+				}
 				
 				FrameInfo frameInfo {
 					frameIndex,
@@ -159,7 +230,10 @@ namespace VTA
 					commandBuffer,
 					camera,
 					descriptorSets[frameIndex],
-					gameObjects
+					gameObjects,
+					&frameDescriptors,
+					PARALLEL_RECORDING ? &parallelRecorder : nullptr,
+					&descriptorCache
 				};
 
 				// update
@@ -172,21 +246,125 @@ namespace VTA
 				globalUboBuffer.flushIndex(frameIndex); // flush the uniform buffer for the current frame
 				
 				// render
-				
-				renderer.beginSwapChainRenderPass(commandBuffer); // begin the render pass for the swap chain
-				simpleRenderSystem.renderGameObjects(frameInfo); // render the game objects
-				pointLightSystemSystem.render(frameInfo);
-				
-				FrameMark;
-				TracyVkCollect(tracyVkCtx, commandBuffer);
-				
-				renderer.endSwapChainRenderPass(commandBuffer); // end the render pass for the swap chain
+				frameGraph.reset();
+				// the swap chain's render pass does the transitions of its image itself
+				auto swapChainImage = frameGraph.importExternallySynchronized("swap chain");
+				// the draws the cull pass writes are what the scene pass draws, the graph puts the barriers in between
+				VkBuffer drawBuffer = indirectRenderSystem ? indirectRenderSystem->getDrawBuffer(frameIndex) : VK_NULL_HANDLE;
+				VkBuffer countBuffer = indirectRenderSystem ? indirectRenderSystem->getCountBuffer(frameIndex) : VK_NULL_HANDLE;
+				auto draws = drawBuffer ? frameGraph.importBuffer("draws", drawBuffer) : 0;
+				auto drawCount = countBuffer ? frameGraph.importBuffer("draw count", countBuffer) : 0;
+				if (countBuffer)
+				{
+					frameGraph.addPass("reset draw count",
+						[&](VTAFrameGraph::PassBuilder& builder)
+						{
+							builder.write(drawCount, FrameGraphUsage::TransferDestination, true);
+						},
+						[&](VkCommandBuffer commandBuffer)
+						{
+							indirectRenderSystem->resetDrawCount(frameInfo);
+						});
+				}
+				if (drawBuffer)
+				{
+					frameGraph.addPass("cull",
+						[&](VTAFrameGraph::PassBuilder& builder)
+						{
+							builder.write(draws, FrameGraphUsage::ComputeStorage, true); // every slot the draw reads is written
+							if (countBuffer) builder.write(drawCount, FrameGraphUsage::ComputeStorage);
+						},
+						[&](VkCommandBuffer commandBuffer)
+						{
+							indirectRenderSystem->cull(frameInfo);
+						});
+				}
+				frameGraph.addPass("scene",
+					[&](VTAFrameGraph::PassBuilder& builder)
+					{
+						builder.write(swapChainImage, FrameGraphUsage::ColorAttachment, true); // cleared on load
+						if (drawBuffer) builder.read(draws, FrameGraphUsage::IndirectCommand);
+						if (countBuffer) builder.read(drawCount, FrameGraphUsage::IndirectCommand);
+					},
+					[&](VkCommandBuffer commandBuffer)
+					{
+						renderer.beginSwapChainRenderPass(commandBuffer, // begin the render pass for the swap chain
+							PARALLEL_RECORDING ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+						if (indirectRenderSystem)
+						{
+							indirectRenderSystem->render(frameInfo);
+						}
+						if (simpleRenderSystem)
+						{
+							simpleRenderSystem->renderGameObjects(frameInfo); // render the game objects
+						}
+						if (atlasRenderSystem)
+						{
+							atlasRenderSystem->renderGameObjects(frameInfo);
+						}
+						pointLightSystemSystem.render(frameInfo);
+
+						FrameMark;
+
+						renderer.endSwapChainRenderPass(commandBuffer); // end the render pass for the swap chain
+					});
+				frameGraph.compile();
+				frameGraph.execute(commandBuffer);
+				if (frameGraph.getStats() != frameGraphStats)
+				{
+					// printed when the graph's shape changes, not every frame
+					frameGraphStats = frameGraph.getStats();
+					std::cout << "frame graph: " << frameGraphStats.passesCulled << " passes culled, " << frameGraphStats.barriers << " barriers\n";
+				}
+				TracyVkCollect(tracyVkCtx, commandBuffer); // resets queries, which isn't allowed inside the pass
 				renderer.endFrame(); // end the frame and submit the command buffer
-				
+
+				if (VALIDATE_GPU_CULL && indirectRenderSystem)
+				{
+					// the camera is still the one this frame culled with
+					vkDeviceWaitIdle(device.device());
+					uint32_t objectCount = indirectRenderSystem->getObjectCount();
+					std::vector<VkDrawIndexedIndirectCommand> gpuDraws(objectCount, VkDrawIndexedIndirectCommand{});
+					std::vector<VkDrawIndexedIndirectCommand> cpuDraws(objectCount, VkDrawIndexedIndirectCommand{});
+					for (auto& draw : indirectRenderSystem->readBackDraws(frameIndex))
+					{
+						// firstInstance is the object index the cull wrote, a bad compaction can put anything there
+						if (draw.firstInstance >= gpuDraws.size())
+						{
+							std::cout << "gpu cull wrote a draw for object " << draw.firstInstance << ", there are only " << objectCount << "\n";
+							continue;
+						}
+						gpuDraws[draw.firstInstance] = draw;
+					}
+					for (auto& draw : indirectRenderSystem->cullOnCpu(camera.getProjection() * camera.getView())) cpuDraws[draw.firstInstance] = draw;
+
+					// an object on a frustum plane can round either way, so mismatches are reported rather than thrown
+					for (uint32_t i = 0; i < objectCount; i++)
+					{
+						const auto& gpu = gpuDraws[i];
+						const auto& cpu = cpuDraws[i];
+						if (gpu.instanceCount != cpu.instanceCount || gpu.indexCount != cpu.indexCount || gpu.firstIndex != cpu.firstIndex
+							|| gpu.vertexOffset != cpu.vertexOffset || gpu.firstInstance != cpu.firstInstance)
+						{
+							std::cout << "gpu cull of object " << i << " doesn't match the CPU: " << (gpu.instanceCount ? "drawn" : "culled")
+								<< " on the GPU, " << (cpu.instanceCount ? "drawn" : "culled") << " on the CPU\n";
+						}
+					}
+				}
 			}
 		}
 		TracyVkDestroy(tracyVkCtx);
 		vkDeviceWaitIdle(device.device()); // wait for the device to finish all operations before destroying resources
+
+		for (uint32_t i = 0; i < VTASwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			auto stats = frameDescriptors.getStats(i);
+			std::cout << "frame " << i << " descriptors: high-water mark " << stats.highWaterMark
+				<< " sets, " << stats.poolCount << " pools\n";
+		}
+		auto cacheStats = descriptorCache.getStats();
+		std::cout << "descriptor cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+			<< cacheStats.retired << " retired, " << cacheStats.recycled << " recycled\n";
 	}
 
     
@@ -6,8 +6,18 @@
 #include "VTA_model.h"
 #include "VTA_game_object.h"
 #include "VTA_descriptors.h"
+#include "VTA_descriptor_cache.h"
 #include "VTA_image.h"
+#include "VTA_bindless.h"
+#include "VTA_texture_atlas.h"
+#include "VTA_mip_downsampler.h"
+#include "VTA_thread_pool.h"
+#include "VTA_pipeline_compiler.h"
+#include "VTA_shader_watcher.h"
+#include "VTA_parallel_recorder.h"
+#include "VTA_frame_graph.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -18,6 +28,12 @@ namespace VTA
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		static constexpr bool PARALLEL_RECORDING = true; // draws go into secondaries recorded on the thread pool
+		static constexpr bool GPU_DRIVEN = true; // culling and draw commands come from a compute pass where the device can do it
+		static constexpr bool BENCHMARK_MIPGEN = false; // times the SIMD mip generator against the scalar one and checks they match
+		static constexpr bool BENCHMARK_DRAW_SORT = false; // times the draw list's sorts on 100k keys before the first frame
+		static constexpr bool VALIDATE_GPU_CULL = false; // waits for every frame and checks its GPU culled draws against a CPU cull
+		static constexpr bool SHADER_HOT_RELOAD = false; // saving a shader source in the working directory recompiles it with glslc
 
 
 		AppControl();
@@ -39,12 +55,24 @@ namespace VTA
 		VTADevice device{ window };
 		VTARenderer renderer{ window, device };
 
-		std::vector<VTADescriptorAllocatorGrowable> descriptorAllocators;
 		std::vector<std::vector<VkDescriptorSet>> descriptorSets;
 		VTAGameObject::Map gameObjects;
 
-		VTA_Image::Texture testTexture{ device, "Textures/OnyxTexture4K.jpg" };
-		VTA_Image::Texture mipmapTexture{ device, "Textures/CheckerboardTexture.jpg" };
+		VTAThreadPool threadPool;
+		VTAPipelineCompiler pipelineCompiler{ device, threadPool }; // render systems build their pipelines on the pool
+		// saving a shader source recompiles it and rebuilds the pipelines using it, stopped before the compiler goes.
+		// Null without SHADER_HOT_RELOAD
+		std::unique_ptr<VTAShaderWatcher> shaderWatcher = SHADER_HOT_RELOAD ?
+			std::make_unique<VTAShaderWatcher>(".", [this](const std::string& spirvFilePath) { pipelineCompiler.reload(spirvFilePath); }) : nullptr;
+		VTAParallelRecorder parallelRecorder{ device, threadPool };
+		VTAFrameGraph frameGraph{ device }; // declared again every frame
+		VTAMipDownsampler mipDownsampler{ device }; // declared before the textures, they generate their mips with it
+		// a model's textureDSindex - 1 indexes both. Null where the texture only lives in the atlas
+		static constexpr std::array<const char*, 2> TEXTURE_FILES{ "Textures/OnyxTexture4K.jpg", "Textures/CheckerboardTexture.jpg" };
+		std::vector<std::unique_ptr<VTA_Image::Texture>> textures;
+
+		std::unique_ptr<VTABindlessTextures> bindlessTextures; // only created when the device supports descriptor indexing
+		std::unique_ptr<VTA_Image::TextureAtlas> textureAtlas; // otherwise the small textures share one atlas and one descriptor set
 
 		
 	};
@@ -0,0 +1,85 @@
+#include "VTA_bindless.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VTA
+{
+	VTABindlessTextures::VTABindlessTextures(VTADevice& device) : device{ device }
+	{
+		assert(isSupported(device) && "Bindless textures need descriptor indexing support");
+
+		capacity = std::min(MAX_TEXTURES, device.maxBindlessTextures);
+
+		// partially bound: unused slots may stay unwritten. update after bind: new textures can be registered while the set is in use
+		setLayout = VTADescriptorSetLayout::Builder(device)
+			.addBinding(TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, capacity,
+				VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+			.setFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT)
+			.build();
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = capacity;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1; // the whole array lives in a single set shared by every frame
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate bindless descriptor set!");
+		}
+	}
+
+	VTABindlessTextures::~VTABindlessTextures()
+	{
+		vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr); // frees the set as well
+	}
+
+	uint32_t VTABindlessTextures::registerTexture(VTA_Image::Texture& texture)
+	{
+		if (textureCount >= capacity)
+		{
+			throw std::runtime_error("bindless texture array is full!");
+		}
+
+		uint32_t index = textureCount++;
+
+		auto imageInfo = texture.descriptorInfo();
+		VTADescriptorWriter writer{ *setLayout };
+		writer.writeImageArrayElement(TEXTURE_BINDING, index, &imageInfo);
+		writer.overwrite(descriptorSet, device);
+
+		return index;
+	}
+
+	void VTABindlessTextures::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex)
+	{
+		vkCmdBindDescriptorSets(commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			setIndex, 1,
+			&descriptorSet,
+			0,
+			nullptr);
+	}
+}
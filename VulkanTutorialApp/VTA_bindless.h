@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VTA_device.hpp"
+#include "VTA_descriptors.h"
+#include "VTA_image.h"
+
+#include <memory>
+
+namespace VTA
+{
+	// One large, partially bound sampled image array that is bound once per frame.
+	// Registering a texture gives it a stable index into the array; shaders select the texture
+	// with that index instead of us binding a descriptor set per object.
+	//
+	// shader side: layout(set = X, binding = 0) uniform sampler2D textures[];
+	//              texture(textures[nonuniformEXT(index)], uv)
+	class VTABindlessTextures
+	{
+	public:
+		static constexpr uint32_t MAX_TEXTURES = 16384;
+		static constexpr uint32_t TEXTURE_BINDING = 0;
+
+		VTABindlessTextures(VTADevice& device);
+		~VTABindlessTextures();
+
+		VTABindlessTextures(const VTABindlessTextures&) = delete;
+		VTABindlessTextures& operator=(const VTABindlessTextures&) = delete;
+
+		static bool isSupported(const VTADevice& device) { return device.descriptorIndexingSupported; }
+
+		// the set is update-after-bind, so this can be called while earlier frames are still in flight
+		uint32_t registerTexture(VTA_Image::Texture& texture);
+
+		void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex);
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		uint32_t getTextureCount() const { return textureCount; }
+		uint32_t getCapacity() const { return capacity; }
+
+	private:
+		VTADevice& device;
+
+		std::unique_ptr<VTADescriptorSetLayout> setLayout;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		uint32_t capacity;
+		uint32_t textureCount = 0;
+	};
+}
@@ -0,0 +1,148 @@
+#include "VTA_descriptor_buffer.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace VTA {
+
+    VTADescriptorBackend VTADescriptorBuffer::resolve(VTADevice& device, VTADescriptorBackend backend) {
+        if (backend == VTADescriptorBackend::Auto) {
+            return isSupported(device) ? VTADescriptorBackend::DescriptorBuffer : VTADescriptorBackend::Pool;
+        }
+        if (backend == VTADescriptorBackend::DescriptorBuffer && !isSupported(device)) {
+            throw std::runtime_error("descriptor buffers requested but VK_EXT_descriptor_buffer is not supported!");
+        }
+        return backend;
+    }
+
+    VTADescriptorBuffer::VTADescriptorBuffer(VTADevice& device, VkDeviceSize size) : device{ device } {
+        assert(isSupported(device) && "Descriptor buffers need VK_EXT_descriptor_buffer");
+
+        // one buffer holds resource and sampler descriptors, combined image samplers need both
+        usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+            VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+        buffer = std::make_unique<VTABuffer>(device, size, 1, usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        if (buffer->map() != VK_SUCCESS) {
+            throw std::runtime_error("failed to map descriptor buffer!");
+        }
+
+        VkBufferDeviceAddressInfo addressInfo{};
+        addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        addressInfo.buffer = buffer->getBuffer();
+        bufferAddress = vkGetBufferDeviceAddress(device.device(), &addressInfo);
+    }
+
+    VkDeviceSize VTADescriptorBuffer::allocate(const VTADescriptorSetLayout& layout) {
+        assert(layout.isDescriptorBufferLayout() && "Layout was not built for descriptor buffers");
+
+        VkDeviceSize alignment = device.descriptorBufferProperties.descriptorBufferOffsetAlignment;
+        VkDeviceSize setSize = (layout.getDescriptorBufferSize() + alignment - 1) & ~(alignment - 1);
+
+        // only advanced when the set fits, a failed allocation leaves the space for smaller ones
+        VkDeviceSize offset = usedSize.load();
+        do {
+            if (offset + setSize > getSize()) {
+                throw std::runtime_error("descriptor buffer is full!");
+            }
+        } while (!usedSize.compare_exchange_weak(offset, offset + setSize));
+        return offset;
+    }
+
+    size_t VTADescriptorBuffer::descriptorSize(VkDescriptorType type) const {
+        const auto& properties = device.descriptorBufferProperties;
+        switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+            return properties.samplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            return properties.combinedImageSamplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            return properties.sampledImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            return properties.storageImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return properties.inputAttachmentDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            return properties.uniformBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            return properties.storageBufferDescriptorSize;
+        default:
+            // dynamic buffers don't exist with descriptor buffers, they are bound by offset anyway
+            throw std::runtime_error("descriptor type not supported by descriptor buffers!");
+        }
+    }
+
+    void VTADescriptorBuffer::write(VkDeviceSize setOffset, const VTADescriptorSetLayout& layout, const VkWriteDescriptorSet& write) {
+        size_t size = descriptorSize(write.descriptorType);
+        auto* base = static_cast<char*>(buffer->getMappedMemory()) + setOffset + layout.getDescriptorBufferOffset(write.dstBinding);
+
+        for (uint32_t i = 0; i < write.descriptorCount; i++) {
+            VkDescriptorGetInfoEXT getInfo{};
+            getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+            getInfo.type = write.descriptorType;
+
+            VkDescriptorAddressInfoEXT addressInfo{};
+            switch (write.descriptorType) {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+                getInfo.data.pSampler = &write.pImageInfo[i].sampler;
+                break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                getInfo.data.pCombinedImageSampler = &write.pImageInfo[i];
+                break;
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                getInfo.data.pSampledImage = &write.pImageInfo[i];
+                break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                getInfo.data.pStorageImage = &write.pImageInfo[i];
+                break;
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                getInfo.data.pInputAttachmentImage = &write.pImageInfo[i];
+                break;
+            default: {
+                const VkDescriptorBufferInfo& bufferInfo = write.pBufferInfo[i];
+                assert(bufferInfo.range != VK_WHOLE_SIZE && "Descriptor buffers need the actual range of a buffer");
+
+                VkBufferDeviceAddressInfo deviceAddressInfo{};
+                deviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+                deviceAddressInfo.buffer = bufferInfo.buffer;
+
+                addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+                addressInfo.address = vkGetBufferDeviceAddress(device.device(), &deviceAddressInfo) + bufferInfo.offset;
+                addressInfo.range = bufferInfo.range;
+                addressInfo.format = VK_FORMAT_UNDEFINED;
+                if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                    getInfo.data.pUniformBuffer = &addressInfo;
+                }
+                else {
+                    getInfo.data.pStorageBuffer = &addressInfo;
+                }
+                break;
+            }
+            }
+
+            device.getDescriptor(device.device(), &getInfo, size, base + (write.dstArrayElement + i) * size);
+        }
+    }
+
+    void VTADescriptorBuffer::bindBuffer(VkCommandBuffer commandBuffer) {
+        VkDescriptorBufferBindingInfoEXT bindingInfo{};
+        bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+        bindingInfo.address = bufferAddress;
+        bindingInfo.usage = usage;
+        device.cmdBindDescriptorBuffers(commandBuffer, 1, &bindingInfo);
+    }
+
+    void VTADescriptorBuffer::bindSet(
+        VkCommandBuffer commandBuffer,
+        VkPipelineBindPoint bindPoint,
+        VkPipelineLayout pipelineLayout,
+        uint32_t set,
+        VkDeviceSize setOffset) {
+        uint32_t bufferIndex = 0; // the one buffer bound by bindBuffer
+        device.cmdSetDescriptorBufferOffsets(commandBuffer, bindPoint, pipelineLayout, set, 1, &bufferIndex, &setOffset);
+    }
+
+}
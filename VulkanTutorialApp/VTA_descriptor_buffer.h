@@ -0,0 +1,64 @@
+#pragma once
+
+#include "VTA_descriptors.h"
+#include "VTA_buffer.h"
+
+// std
+#include <atomic>
+#include <memory>
+
+namespace VTA {
+
+    // which descriptor path a system should build its sets with
+    enum class VTADescriptorBackend {
+        Auto,             // descriptor buffers when the device has them, pools otherwise
+        Pool,
+        DescriptorBuffer,
+    };
+
+    // Descriptor sets written straight into a persistently mapped buffer with vkGetDescriptorEXT
+    // (VK_EXT_descriptor_buffer) and bound by offset. Sets are linear sub-allocations, so there are no pools
+    // and nothing is freed set by set: reset() drops all of them once the GPU is done with the buffer.
+    // allocate and write are plain atomics and memcpys, worker threads can fill their own sets.
+    // Layouts need Builder::useDescriptorBuffer and pipelines VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT.
+    class VTADescriptorBuffer {
+    public:
+        static bool isSupported(VTADevice& device) { return device.descriptorBufferSupported; }
+        // Auto becomes whatever the device supports, an explicit choice is kept
+        static VTADescriptorBackend resolve(VTADevice& device, VTADescriptorBackend backend);
+
+        VTADescriptorBuffer(VTADevice& device, VkDeviceSize size);
+
+        VTADescriptorBuffer(const VTADescriptorBuffer&) = delete;
+        VTADescriptorBuffer& operator=(const VTADescriptorBuffer&) = delete;
+
+        // offset of a new set of layout within the buffer
+        VkDeviceSize allocate(const VTADescriptorSetLayout& layout);
+        void reset() { usedSize = 0; }
+
+        // writes the descriptors of one VkWriteDescriptorSet into the set at setOffset, dstSet is ignored
+        void write(VkDeviceSize setOffset, const VTADescriptorSetLayout& layout, const VkWriteDescriptorSet& write);
+
+        // once per command buffer, before any bindSet
+        void bindBuffer(VkCommandBuffer commandBuffer);
+        void bindSet(
+            VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint bindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t set,
+            VkDeviceSize setOffset);
+
+        VkDeviceSize getUsedSize() const { return usedSize; }
+        VkDeviceSize getSize() const { return buffer->getBufferSize(); }
+
+    private:
+        size_t descriptorSize(VkDescriptorType type) const;
+
+        VTADevice& device;
+        std::unique_ptr<VTABuffer> buffer;
+        VkBufferUsageFlags usage;
+        VkDeviceAddress bufferAddress;
+        std::atomic<VkDeviceSize> usedSize{ 0 };
+    };
+
+}
@@ -0,0 +1,197 @@
+#include "VTA_descriptor_cache.h"
+#include "VTA_utils.h"
+
+// std
+#include <algorithm>
+#include <iterator>
+
+namespace VTA {
+
+    namespace {
+
+        // non-dispatchable handles are pointers on 64 bit and integers on 32 bit platforms
+        template <typename T>
+        uint64_t handleKey(T handle) {
+            return (uint64_t)handle;
+        }
+
+    }
+
+    // *************** Request *********************
+
+    bool VTADescriptorCache::Request::Binding::operator==(const Binding& other) const {
+        if (binding != other.binding || arrayElement != other.arrayElement || isImage != other.isImage) {
+            return false;
+        }
+        if (isImage) {
+            return imageInfo.sampler == other.imageInfo.sampler &&
+                imageInfo.imageView == other.imageInfo.imageView &&
+                imageInfo.imageLayout == other.imageInfo.imageLayout;
+        }
+        return bufferInfo.buffer == other.bufferInfo.buffer &&
+            bufferInfo.offset == other.bufferInfo.offset &&
+            bufferInfo.range == other.bufferInfo.range;
+    }
+
+    void VTADescriptorCache::Request::insert(const Binding& entry) {
+        auto position = std::lower_bound(bindings.begin(), bindings.end(), entry, [](const Binding& a, const Binding& b) {
+            return a.binding != b.binding ? a.binding < b.binding : a.arrayElement < b.arrayElement;
+            });
+        bindings.insert(position, entry);
+    }
+
+    VTADescriptorCache::Request& VTADescriptorCache::Request::buffer(uint32_t binding, const VkDescriptorBufferInfo& info) {
+        insert(Binding{ binding, 0, false, info, {} });
+        return *this;
+    }
+
+    VTADescriptorCache::Request& VTADescriptorCache::Request::image(uint32_t binding, const VkDescriptorImageInfo& info, uint32_t arrayElement) {
+        insert(Binding{ binding, arrayElement, true, {}, info });
+        return *this;
+    }
+
+    // *************** Cache *********************
+
+    bool VTADescriptorCache::Key::operator==(const Key& other) const {
+        return layout == other.layout && bindings == other.bindings;
+    }
+
+    size_t VTADescriptorCache::KeyHash::operator()(const Key& key) const {
+        size_t seed = 0;
+        hashCombine(seed, handleKey(key.layout));
+        for (auto& b : key.bindings) {
+            hashCombine(seed, b.binding, b.arrayElement, b.isImage);
+            if (b.isImage) {
+                hashCombine(seed, handleKey(b.imageInfo.sampler), handleKey(b.imageInfo.imageView), static_cast<uint32_t>(b.imageInfo.imageLayout));
+            }
+            else {
+                hashCombine(seed, handleKey(b.bufferInfo.buffer), b.bufferInfo.offset, b.bufferInfo.range);
+            }
+        }
+        return seed;
+    }
+
+    VTADescriptorCache::VTADescriptorCache(
+        VTADevice& device,
+        std::span<VTADescriptorAllocatorGrowable::PoolSizeRatio> poolRatios,
+        uint32_t framesInFlight,
+        uint32_t initialSets)
+        : device{ device }, framesInFlight{ framesInFlight } {
+        allocator.init(device.device(), initialSets, poolRatios);
+    }
+
+    VTADescriptorCache::~VTADescriptorCache() {
+        allocator.destroy_pools(device.device());
+    }
+
+    VkDescriptorSet VTADescriptorCache::get(const Request& request) {
+        Key key{ request.layout.getDescriptorSetLayout(), request.bindings };
+
+        auto found = entries.find(key);
+        if (found != entries.end()) {
+            stats.hits++;
+            return found->second;
+        }
+        stats.misses++;
+
+        VkDescriptorSet set;
+        auto& freeList = freeSets[key.layout];
+        if (!freeList.empty()) {
+            set = freeList.back();
+            freeList.pop_back();
+            stats.recycled++;
+        }
+        else {
+            set = allocator.allocate(device.device(), key.layout);
+        }
+
+        // the writer keeps pointers to the infos until overwrite, so it gets its own copy
+        std::vector<Request::Binding> infos = request.bindings;
+        VTADescriptorWriter writer{ request.layout };
+        for (auto& b : infos) {
+            if (b.isImage) {
+                writer.writeImageArrayElement(b.binding, b.arrayElement, &b.imageInfo);
+            }
+            else {
+                writer.writeBuffer(b.binding, &b.bufferInfo);
+            }
+        }
+        writer.overwrite(set, device);
+
+        const Key* stored = &entries.emplace(std::move(key), set).first->first;
+        for (uint64_t handle : resourceHandles(*stored)) {
+            keysByResource.emplace(handle, stored);
+        }
+        return set;
+    }
+
+    std::vector<uint64_t> VTADescriptorCache::resourceHandles(const Key& key) {
+        std::vector<uint64_t> handles;
+        for (auto& b : key.bindings) {
+            if (b.isImage) {
+                if (b.imageInfo.imageView != VK_NULL_HANDLE) handles.push_back(handleKey(b.imageInfo.imageView));
+                if (b.imageInfo.sampler != VK_NULL_HANDLE) handles.push_back(handleKey(b.imageInfo.sampler));
+            }
+            else {
+                handles.push_back(handleKey(b.bufferInfo.buffer));
+            }
+        }
+        // one reverse entry per resource, even if several bindings share it
+        std::sort(handles.begin(), handles.end());
+        handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+        return handles;
+    }
+
+    void VTADescriptorCache::invalidate(VkBuffer buffer) {
+        invalidateHandle(handleKey(buffer));
+    }
+
+    void VTADescriptorCache::invalidate(VkImageView imageView) {
+        invalidateHandle(handleKey(imageView));
+    }
+
+    void VTADescriptorCache::invalidate(VkSampler sampler) {
+        invalidateHandle(handleKey(sampler));
+    }
+
+    void VTADescriptorCache::invalidateHandle(uint64_t handle) {
+        std::vector<const Key*> dead;
+        auto range = keysByResource.equal_range(handle);
+        for (auto it = range.first; it != range.second; ++it) {
+            dead.push_back(it->second);
+        }
+
+        for (const Key* key : dead) {
+            retire(key);
+        }
+    }
+
+    void VTADescriptorCache::retire(const Key* key) {
+        // drop the reverse entries of every resource in this key before the key itself goes away
+        for (uint64_t handle : resourceHandles(*key)) {
+            auto range = keysByResource.equal_range(handle);
+            for (auto it = range.first; it != range.second;) {
+                it = it->second == key ? keysByResource.erase(it) : std::next(it);
+            }
+        }
+
+        auto entry = entries.find(*key);
+        retiredSets.push_back({ entry->first.layout, entry->second, frame });
+        entries.erase(entry);
+        stats.retired++;
+    }
+
+    void VTADescriptorCache::nextFrame() {
+        frame++;
+
+        // sets retired framesInFlight frames ago can no longer be bound by a command buffer in flight
+        auto reusable = std::partition(retiredSets.begin(), retiredSets.end(), [&](const RetiredSet& retired) {
+            return retired.frame + framesInFlight > frame;
+            });
+        for (auto it = reusable; it != retiredSets.end(); ++it) {
+            freeSets[it->layout].push_back(it->set);
+        }
+        retiredSets.erase(reusable, retiredSets.end());
+    }
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "VTA_descriptors.h"
+
+// std
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace VTA {
+
+    // Hands out descriptor sets keyed by their layout and every resource written into them.
+    // A request matching an earlier one gets the same set back without a vkUpdateDescriptorSets call,
+    // so repeated materials cost no descriptor updates after their first use.
+    // Sets that reference a destroyed resource are retired, and recycled for new requests once the
+    // frames that may still have them bound are finished.
+    class VTADescriptorCache {
+    public:
+        class Request {
+        public:
+            Request(VTADescriptorSetLayout& layout) : layout{ layout } {}
+
+            Request& buffer(uint32_t binding, const VkDescriptorBufferInfo& info);
+            Request& image(uint32_t binding, const VkDescriptorImageInfo& info, uint32_t arrayElement = 0);
+
+            struct Binding {
+                uint32_t binding;
+                uint32_t arrayElement;
+                bool isImage;
+                VkDescriptorBufferInfo bufferInfo;
+                VkDescriptorImageInfo imageInfo;
+
+                bool operator==(const Binding& other) const;
+            };
+
+        private:
+            void insert(const Binding& entry);
+
+            VTADescriptorSetLayout& layout;
+            std::vector<Binding> bindings; // sorted, the order of the calls doesn't change the key
+
+            friend class VTADescriptorCache;
+        };
+
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t retired = 0;  // dropped because a resource they referenced was invalidated
+            uint64_t recycled = 0; // misses served by rewriting a retired set instead of allocating
+        };
+
+        VTADescriptorCache(
+            VTADevice& device,
+            std::span<VTADescriptorAllocatorGrowable::PoolSizeRatio> poolRatios,
+            uint32_t framesInFlight,
+            uint32_t initialSets = 64);
+        ~VTADescriptorCache();
+
+        VTADescriptorCache(const VTADescriptorCache&) = delete;
+        VTADescriptorCache& operator=(const VTADescriptorCache&) = delete;
+
+        VkDescriptorSet get(const Request& request);
+
+        // call before the resource is destroyed, every set that references it is retired
+        void invalidate(VkBuffer buffer);
+        void invalidate(VkImageView imageView);
+        void invalidate(VkSampler sampler);
+
+        // once per frame after the in-flight fence wait, makes sets retired framesInFlight frames ago reusable
+        void nextFrame();
+
+        const Stats& getStats() const { return stats; }
+        size_t size() const { return entries.size(); }
+
+    private:
+        struct Key {
+            VkDescriptorSetLayout layout;
+            std::vector<Request::Binding> bindings;
+
+            bool operator==(const Key& other) const;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct RetiredSet {
+            VkDescriptorSetLayout layout;
+            VkDescriptorSet set;
+            uint64_t frame;
+        };
+
+        static std::vector<uint64_t> resourceHandles(const Key& key);
+        void invalidateHandle(uint64_t handle);
+        void retire(const Key* key);
+
+        VTADevice& device;
+        VTADescriptorAllocatorGrowable allocator;
+        uint32_t framesInFlight;
+
+        std::unordered_map<Key, VkDescriptorSet, KeyHash> entries;
+        std::unordered_multimap<uint64_t, const Key*> keysByResource; // map nodes don't move, the key pointers stay valid
+        std::vector<RetiredSet> retiredSets;
+        std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+
+        uint64_t frame = 0;
+        Stats stats;
+    };
+
+}
@@ -1,18 +1,37 @@
 #include "VTA_descriptors.h"
+#include "VTA_descriptor_buffer.h"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 namespace VTA {
 
+    static bool isImageDescriptor(VkDescriptorType type) {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+            type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+            type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+            type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+            type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+
+    static bool isBufferDescriptor(VkDescriptorType type) {
+        return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+            type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+            type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+
     // *************** Descriptor Set Layout Builder *********************
 
     VTADescriptorSetLayout::Builder& VTADescriptorSetLayout::Builder::addBinding(
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count) {
+        uint32_t count,
+        VkDescriptorBindingFlags flags) {
         assert(bindings.count(binding) == 0 && "Binding already in use");
         VkDescriptorSetLayoutBinding layoutBinding{};
         layoutBinding.binding = binding;
@@ -20,39 +39,170 @@ namespace VTA {
         layoutBinding.descriptorCount = count;
         layoutBinding.stageFlags = stageFlags;
         bindings[binding] = layoutBinding;
+        if (flags != 0) {
+            bindingFlags[binding] = flags;
+        }
+        return *this;
+    }
+
+    VTADescriptorSetLayout::Builder& VTADescriptorSetLayout::Builder::setFlags(
+        VkDescriptorSetLayoutCreateFlags flags) {
+        layoutFlags = flags;
+        return *this;
+    }
+
+    VTADescriptorSetLayout::Builder& VTADescriptorSetLayout::Builder::usePushDescriptors() {
+        pushDescriptors = true;
+        return *this;
+    }
+
+    VTADescriptorSetLayout::Builder& VTADescriptorSetLayout::Builder::useDescriptorBuffer() {
+        assert(device.descriptorBufferSupported && "Descriptor buffer layout on a device without VK_EXT_descriptor_buffer");
+        descriptorBuffer = true;
         return *this;
     }
 
     std::unique_ptr<VTADescriptorSetLayout> VTADescriptorSetLayout::Builder::build() const {
-        return std::make_unique<VTADescriptorSetLayout>(device, bindings);
+        VkDescriptorSetLayoutCreateFlags flags = layoutFlags;
+        if (descriptorBuffer) {
+            flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+        }
+        if (pushDescriptors && device.pushDescriptorSupported) {
+            uint32_t descriptorCount = 0;
+            for (auto& kv : bindings) {
+                descriptorCount += kv.second.descriptorCount;
+            }
+            // too many for one push, such a layout stays a regular one
+            if (descriptorCount <= device.maxPushDescriptors) {
+                flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            }
+        }
+        return std::make_unique<VTADescriptorSetLayout>(device, bindings, bindingFlags, flags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     VTADescriptorSetLayout::VTADescriptorSetLayout(
-        VTADevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
-        : device{ device }, bindings{ bindings } {
+        VTADevice& device,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags,
+        VkDescriptorSetLayoutCreateFlags layoutFlags)
+        : device{ device }, bindings{ bindings }, layoutFlags{ layoutFlags } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
-        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
-        descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-        descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+        // identical layouts built anywhere else share the same handle
+        descriptorSetLayout = device.layoutCache().acquireSetLayout(layoutFlags, setLayoutBindings, setLayoutBindingFlags);
 
-        if (vkCreateDescriptorSetLayout(
-            device.device(),
-            &descriptorSetLayoutInfo,
-            nullptr,
-            &descriptorSetLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create descriptor set layout!");
+        if (isDescriptorBufferLayout()) {
+            device.getDescriptorSetLayoutSize(device.device(), descriptorSetLayout, &descriptorBufferSize);
+            for (auto& kv : bindings) {
+                VkDeviceSize offset;
+                device.getDescriptorSetLayoutBindingOffset(device.device(), descriptorSetLayout, kv.first, &offset);
+                descriptorBufferOffsets[kv.first] = offset;
+            }
+        }
+
+        // the writer still packs its infos for push and descriptor buffer layouts, only the set template is left out
+        createTemplateEntries();
+        if (supportsUpdateTemplate() && !isPushDescriptor() && !isDescriptorBufferLayout()) {
+            updateTemplate = createUpdateTemplate(
+                VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET, VK_NULL_HANDLE, 0, VK_PIPELINE_BIND_POINT_GRAPHICS);
         }
     }
 
     VTADescriptorSetLayout::~VTADescriptorSetLayout() {
-        vkDestroyDescriptorSetLayout(device.device(), descriptorSetLayout, nullptr);
+        for (auto& pushTemplate : pushTemplates) {
+            vkDestroyDescriptorUpdateTemplate(device.device(), pushTemplate.updateTemplate, nullptr);
+        }
+        if (updateTemplate != VK_NULL_HANDLE) {
+            vkDestroyDescriptorUpdateTemplate(device.device(), updateTemplate, nullptr);
+        }
+        device.layoutCache().releaseSetLayout(descriptorSetLayout);
+    }
+
+    void VTADescriptorSetLayout::createTemplateEntries() {
+        std::vector<VkDescriptorSetLayoutBinding> sorted{};
+        for (auto& kv : bindings) {
+            sorted.push_back(kv.second);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+
+        uint32_t offset = 0;
+        for (auto& binding : sorted) {
+            uint32_t stride = 0;
+            if (isImageDescriptor(binding.descriptorType)) {
+                stride = sizeof(VkDescriptorImageInfo);
+            }
+            else if (isBufferDescriptor(binding.descriptorType)) {
+                stride = sizeof(VkDescriptorBufferInfo);
+            }
+
+            // the writer has no way to fill anything else, and big arrays (bindless) are written an element at a time
+            if (stride == 0 ||
+                templateDescriptorCount + binding.descriptorCount > MAX_TEMPLATE_DESCRIPTORS ||
+                offset + stride * binding.descriptorCount > MAX_TEMPLATE_DATA_SIZE) {
+                templateEntries.clear();
+                templateSlots.clear();
+                templateDescriptorCount = 0;
+                return;
+            }
+
+            VkDescriptorUpdateTemplateEntry entry{};
+            entry.dstBinding = binding.binding;
+            entry.dstArrayElement = 0;
+            entry.descriptorCount = binding.descriptorCount;
+            entry.descriptorType = binding.descriptorType;
+            entry.offset = offset;
+            entry.stride = stride;
+            templateEntries.push_back(entry);
+            templateSlots[binding.binding] = TemplateSlot{ offset, stride, templateDescriptorCount };
+
+            offset += stride * binding.descriptorCount;
+            templateDescriptorCount += binding.descriptorCount;
+        }
+    }
+
+    VkDescriptorUpdateTemplate VTADescriptorSetLayout::createUpdateTemplate(
+        VkDescriptorUpdateTemplateType type,
+        VkPipelineLayout pipelineLayout,
+        uint32_t set,
+        VkPipelineBindPoint bindPoint) const {
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+        templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+        templateInfo.templateType = type;
+        templateInfo.descriptorSetLayout = descriptorSetLayout;
+        templateInfo.pipelineBindPoint = bindPoint;
+        templateInfo.pipelineLayout = pipelineLayout;
+        templateInfo.set = set;
+
+        VkDescriptorUpdateTemplate newTemplate;
+        if (vkCreateDescriptorUpdateTemplate(device.device(), &templateInfo, nullptr, &newTemplate) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor update template!");
+        }
+        return newTemplate;
+    }
+
+    VkDescriptorUpdateTemplate VTADescriptorSetLayout::getPushUpdateTemplate(
+        VkPipelineLayout pipelineLayout, uint32_t set, VkPipelineBindPoint bindPoint) {
+        std::lock_guard<std::mutex> lock{ pushTemplateMutex };
+        for (auto& pushTemplate : pushTemplates) {
+            if (pushTemplate.pipelineLayout == pipelineLayout && pushTemplate.set == set && pushTemplate.bindPoint == bindPoint) {
+                return pushTemplate.updateTemplate;
+            }
+        }
+
+        VkDescriptorUpdateTemplate newTemplate = createUpdateTemplate(
+            VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR, pipelineLayout, set, bindPoint);
+        pushTemplates.push_back(PushTemplate{ pipelineLayout, set, bindPoint, newTemplate });
+        return newTemplate;
     }
 
     // *************** Descriptor Pool *********************
@@ -67,11 +217,12 @@ namespace VTA {
             readyPools.pop_back();
         }
         else {
+            // grow geometrically so a busy frame settles on a handful of pools
             newPool = create_pool(device, setsPerPool, ratios);
             setsPerPool = setsPerPool * 1.5f;
-            if (setsPerPool > 4092)
+            if (setsPerPool > MAX_SETS_PER_POOL)
             {
-                setsPerPool = 4092;
+                setsPerPool = MAX_SETS_PER_POOL;
             }
         }
         return newPool;
@@ -84,25 +235,28 @@ namespace VTA {
         {
             poolSizes.push_back(VkDescriptorPoolSize{
                 .type = ratio.type,
-                .descriptorCount = uint32_t(ratio.ratio * setCount)
+                .descriptorCount = std::max(1u, uint32_t(ratio.ratio * setCount))
                 });
         }
 
         VkDescriptorPoolCreateInfo pool_info = {};
         pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        pool_info.flags = 0;
+        pool_info.flags = poolFlags;
         pool_info.maxSets = setCount;
         pool_info.poolSizeCount = (uint32_t)poolSizes.size();
         pool_info.pPoolSizes = poolSizes.data();
 		
 		VkDescriptorPool newPool;
-		vkCreateDescriptorPool(device, &pool_info, nullptr, &newPool);
+		if (vkCreateDescriptorPool(device, &pool_info, nullptr, &newPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
 		return newPool;
 
     }
 
-    void VTADescriptorAllocatorGrowable::init(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios)
+    void VTADescriptorAllocatorGrowable::init(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios, VkDescriptorPoolCreateFlags flags)
     {
+        poolFlags = flags;
         ratios.clear();
 
         for (auto r : poolRatios) {
@@ -126,6 +280,9 @@ namespace VTA {
             readyPools.push_back(p);
         }
         fullPools.clear();
+
+        setsAllocated = 0;
+        setsInCurrentPool = 0;
     }
 
     void VTADescriptorAllocatorGrowable::destroy_pools(VkDevice device)
@@ -138,12 +295,18 @@ namespace VTA {
             vkDestroyDescriptorPool(device, p, nullptr);
         }
         fullPools.clear();
+
+        setsAllocated = 0;
+        setsInCurrentPool = 0;
     }
 
     VkDescriptorSet VTADescriptorAllocatorGrowable::allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext)
     {
-        //get or create a pool to allocate from
-        VkDescriptorPool poolToUse = get_pool(device);
+        // allocations keep coming from the back of readyPools until it runs out
+        if (readyPools.empty()) {
+            readyPools.push_back(get_pool(device));
+        }
+        VkDescriptorPool poolToUse = readyPools.back();
 
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.pNext = pNext;
@@ -158,20 +321,69 @@ namespace VTA {
         //allocation failed. Try again
         if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
 
+            readyPools.pop_back();
             fullPools.push_back(poolToUse);
+            setsInCurrentPool = 0;
 
             poolToUse = get_pool(device);
+            readyPools.push_back(poolToUse);
             allocInfo.descriptorPool = poolToUse;
 
             if (vkAllocateDescriptorSets(device, &allocInfo, &ds) != VK_SUCCESS) {
                 throw std::runtime_error("failed to allocate descriptor set after growing pool!");
 			}
         }
+        else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
 
-        readyPools.push_back(poolToUse);
+        setsAllocated++;
+        setsInCurrentPool++;
+        highWaterMark = std::max(highWaterMark, setsAllocated);
         return ds;
     }
 
+    VTADescriptorAllocatorGrowable::Stats VTADescriptorAllocatorGrowable::getStats() const
+    {
+        Stats stats{};
+        stats.setsAllocated = setsAllocated;
+        stats.poolsInUse = static_cast<uint32_t>(fullPools.size()) + (setsInCurrentPool > 0 ? 1 : 0);
+        stats.poolCount = static_cast<uint32_t>(fullPools.size() + readyPools.size());
+        stats.highWaterMark = highWaterMark;
+        return stats;
+    }
+
+    // *************** Frame Descriptor Allocator *********************
+
+    VTAFrameDescriptorAllocator::VTAFrameDescriptorAllocator(
+        VTADevice& device,
+        uint32_t framesInFlight,
+        uint32_t initialSets,
+        std::span<VTADescriptorAllocatorGrowable::PoolSizeRatio> poolRatios)
+        : device{ device }, allocators(framesInFlight) {
+        for (auto& allocator : allocators) {
+            allocator.init(device.device(), initialSets, poolRatios);
+        }
+    }
+
+    VTAFrameDescriptorAllocator::~VTAFrameDescriptorAllocator() {
+        for (auto& allocator : allocators) {
+            allocator.destroy_pools(device.device());
+        }
+    }
+
+    void VTAFrameDescriptorAllocator::beginFrame(uint32_t frameIndex) {
+        assert(frameIndex < allocators.size() && "Frame index outside of the frames in flight");
+        std::lock_guard<std::mutex> lock{ mutex };
+        currentFrame = frameIndex;
+        allocators[currentFrame].clear_pools(device.device());
+    }
+
+    VkDescriptorSet VTAFrameDescriptorAllocator::allocate(VkDescriptorSetLayout layout, void* pNext) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return allocators[currentFrame].allocate(device.device(), layout, pNext);
+    }
+
 
 
 
@@ -192,6 +404,10 @@ namespace VTA {
             bindingDescription.descriptorCount == 1 &&
             "Binding single descriptor info, but binding expects multiple");
 
+        if (writeTemplateData(binding, 0, bufferInfo, sizeof(*bufferInfo))) {
+            return *this;
+        }
+
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write.descriptorType = bindingDescription.descriptorType;
@@ -213,6 +429,10 @@ namespace VTA {
             bindingDescription.descriptorCount == 1 &&
             "Binding single descriptor info, but binding expects multiple");
 
+        if (writeTemplateData(binding, 0, imageInfo, sizeof(*imageInfo))) {
+            return *this;
+        }
+
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write.descriptorType = bindingDescription.descriptorType;
@@ -224,12 +444,168 @@ namespace VTA {
         return *this;
     }
 
+    VTADescriptorWriter& VTADescriptorWriter::writeImageArrayElement(
+        uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo* imageInfo) {
+        assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+        auto& bindingDescription = setLayout.bindings[binding];
+
+        assert(
+            arrayElement < bindingDescription.descriptorCount &&
+            "Array element is outside of the binding's descriptor count");
+
+        if (writeTemplateData(binding, arrayElement, imageInfo, sizeof(*imageInfo))) {
+            return *this;
+        }
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorType = bindingDescription.descriptorType;
+        write.dstBinding = binding;
+        write.dstArrayElement = arrayElement;
+        write.pImageInfo = imageInfo;
+        write.descriptorCount = 1;
+
+        writes.push_back(write);
+        return *this;
+    }
+
+    bool VTADescriptorWriter::writeTemplateData(uint32_t binding, uint32_t arrayElement, const void* info, size_t infoSize) {
+        if (!setLayout.supportsUpdateTemplate()) {
+            return false;
+        }
+
+        const auto& slot = setLayout.templateSlots.at(binding);
+        assert(slot.stride == infoSize && "Descriptor info does not match the binding's descriptor type");
+
+        std::memcpy(templateData.data() + slot.offset + arrayElement * slot.stride, info, infoSize);
+        writtenDescriptors |= uint64_t{ 1 } << (slot.firstDescriptor + arrayElement);
+        return true;
+    }
+
+    bool VTADescriptorWriter::templateDataComplete() const {
+        uint32_t count = setLayout.templateDescriptorCount;
+        uint64_t all = count == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << count) - 1;
+        return writtenDescriptors == all;
+    }
+
+    uint32_t VTADescriptorWriter::templateWrites(
+        std::array<VkWriteDescriptorSet, VTADescriptorSetLayout::MAX_TEMPLATE_DESCRIPTORS>& out) const {
+        uint32_t writeCount = 0;
+        uint32_t descriptorIndex = 0;
+        for (auto& entry : setLayout.templateEntries) {
+            for (uint32_t i = 0; i < entry.descriptorCount; i++, descriptorIndex++) {
+                if ((writtenDescriptors & (uint64_t{ 1 } << descriptorIndex)) == 0) {
+                    continue;
+                }
+
+                const std::byte* info = templateData.data() + entry.offset + i * entry.stride;
+                VkWriteDescriptorSet write{};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.descriptorType = entry.descriptorType;
+                write.dstBinding = entry.dstBinding;
+                write.dstArrayElement = i;
+                write.descriptorCount = 1;
+                if (isBufferDescriptor(entry.descriptorType)) {
+                    write.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(info);
+                }
+                else {
+                    write.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(info);
+                }
+                out[writeCount++] = write;
+            }
+        }
+        return writeCount;
+    }
 
     void VTADescriptorWriter::overwrite(VkDescriptorSet& set, VTADevice& device) {
+        if (setLayout.supportsUpdateTemplate()) {
+            if (templateDataComplete()) {
+                vkUpdateDescriptorSetWithTemplate(device.device(), set, setLayout.updateTemplate, templateData.data());
+                return;
+            }
+
+            // the template writes every descriptor, a partial update goes through plain writes
+            std::array<VkWriteDescriptorSet, VTADescriptorSetLayout::MAX_TEMPLATE_DESCRIPTORS> partialWrites;
+            uint32_t writeCount = templateWrites(partialWrites);
+            for (uint32_t i = 0; i < writeCount; i++) {
+                partialWrites[i].dstSet = set;
+            }
+            vkUpdateDescriptorSets(device.device(), writeCount, partialWrites.data(), 0, nullptr);
+            return;
+        }
+
         for (auto& write : writes) {
             write.dstSet = set;
         }
         vkUpdateDescriptorSets(device.device(), writes.size(), writes.data(), 0, nullptr);
     }
 
-}
\ No newline at end of file
+    void VTADescriptorWriter::push(
+        VkCommandBuffer commandBuffer,
+        VkPipelineLayout pipelineLayout,
+        uint32_t set,
+        VTAFrameDescriptorAllocator* fallbackAllocator,
+        VkPipelineBindPoint bindPoint) {
+        if (setLayout.isPushDescriptor()) {
+            VTADevice& device = setLayout.device;
+            if (!setLayout.supportsUpdateTemplate()) {
+                device.cmdPushDescriptorSet(
+                    commandBuffer,
+                    bindPoint,
+                    pipelineLayout,
+                    set,
+                    static_cast<uint32_t>(writes.size()),
+                    writes.data());
+                return;
+            }
+
+            if (templateDataComplete() && device.cmdPushDescriptorSetWithTemplate != nullptr) {
+                device.cmdPushDescriptorSetWithTemplate(
+                    commandBuffer,
+                    setLayout.getPushUpdateTemplate(pipelineLayout, set, bindPoint),
+                    pipelineLayout,
+                    set,
+                    templateData.data());
+                return;
+            }
+
+            std::array<VkWriteDescriptorSet, VTADescriptorSetLayout::MAX_TEMPLATE_DESCRIPTORS> pushWrites;
+            uint32_t writeCount = templateWrites(pushWrites);
+            device.cmdPushDescriptorSet(commandBuffer, bindPoint, pipelineLayout, set, writeCount, pushWrites.data());
+            return;
+        }
+
+        assert(fallbackAllocator != nullptr && "Layout is not a push descriptor layout and there is no allocator to fall back to");
+        assert(!setLayout.isDescriptorBufferLayout() && "Descriptor buffer layouts are bound through VTADescriptorBuffer");
+
+        VkDescriptorSet descriptorSet = fallbackAllocator->allocate(setLayout.getDescriptorSetLayout());
+        overwrite(descriptorSet, setLayout.device);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            bindPoint,
+            pipelineLayout,
+            set, 1,
+            &descriptorSet,
+            0,
+            nullptr);
+    }
+
+    void VTADescriptorWriter::overwrite(VTADescriptorBuffer& descriptorBuffer, VkDeviceSize setOffset) {
+        assert(setLayout.isDescriptorBufferLayout() && "Layout was not built for descriptor buffers");
+
+        if (setLayout.supportsUpdateTemplate()) {
+            std::array<VkWriteDescriptorSet, VTADescriptorSetLayout::MAX_TEMPLATE_DESCRIPTORS> packedWrites;
+            uint32_t writeCount = templateWrites(packedWrites);
+            for (uint32_t i = 0; i < writeCount; i++) {
+                descriptorBuffer.write(setOffset, setLayout, packedWrites[i]);
+            }
+            return;
+        }
+
+        for (auto& write : writes) {
+            descriptorBuffer.write(setOffset, setLayout, write);
+        }
+    }
+
+}
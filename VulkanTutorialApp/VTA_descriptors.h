@@ -3,15 +3,24 @@
 #include "VTA_device.hpp"
 
 // std
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <span>
 
 namespace VTA {
 
+    class VTADescriptorBuffer;
+
     class VTADescriptorSetLayout {
     public:
+        // layouts whose descriptors fit in this much packed data get a descriptor update template
+        static constexpr uint32_t MAX_TEMPLATE_DATA_SIZE = 512;
+        static constexpr uint32_t MAX_TEMPLATE_DESCRIPTORS = 64;
+
         class Builder {
         public:
             Builder(VTADevice& device) : device{ device } {}
@@ -20,26 +29,81 @@ namespace VTA {
                 uint32_t binding,
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
-                uint32_t count = 1);
+                uint32_t count = 1,
+                VkDescriptorBindingFlags bindingFlags = 0);
+            Builder& setFlags(VkDescriptorSetLayoutCreateFlags flags);
+            // descriptors are pushed into the command buffer instead of living in a set.
+            // ignored when the device has no VK_KHR_push_descriptor, VTADescriptorWriter::push handles both
+            Builder& usePushDescriptors();
+            // sets of this layout live in a VTADescriptorBuffer instead of a pool, the device has to support it
+            Builder& useDescriptorBuffer();
             std::unique_ptr<VTADescriptorSetLayout> build() const;
 
         private:
             VTADevice& device;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
+            bool pushDescriptors = false;
+            bool descriptorBuffer = false;
         };
 
         VTADescriptorSetLayout(
-            VTADevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            VTADevice& device,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags = {},
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
         ~VTADescriptorSetLayout();
         VTADescriptorSetLayout(const VTADescriptorSetLayout&) = delete;
         VTADescriptorSetLayout& operator=(const VTADescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        bool isPushDescriptor() const { return (layoutFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) != 0; }
+        bool supportsUpdateTemplate() const { return !templateEntries.empty(); }
+        bool isDescriptorBufferLayout() const { return (layoutFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT) != 0; }
+
+        // bytes one set takes in a descriptor buffer, and where a binding starts in it
+        VkDeviceSize getDescriptorBufferSize() const { return descriptorBufferSize; }
+        VkDeviceSize getDescriptorBufferOffset(uint32_t binding) const { return descriptorBufferOffsets.at(binding); }
 
     private:
+        // where a binding's descriptors sit in the packed template data
+        struct TemplateSlot {
+            uint32_t offset;
+            uint32_t stride;
+            uint32_t firstDescriptor; // index of its first descriptor over the whole layout
+        };
+
+        struct PushTemplate {
+            VkPipelineLayout pipelineLayout;
+            uint32_t set;
+            VkPipelineBindPoint bindPoint;
+            VkDescriptorUpdateTemplate updateTemplate;
+        };
+
+        void createTemplateEntries();
+        VkDescriptorUpdateTemplate createUpdateTemplate(
+            VkDescriptorUpdateTemplateType type,
+            VkPipelineLayout pipelineLayout,
+            uint32_t set,
+            VkPipelineBindPoint bindPoint) const;
+        // push templates are tied to a pipeline layout and set index, so they are created on first use
+        VkDescriptorUpdateTemplate getPushUpdateTemplate(VkPipelineLayout pipelineLayout, uint32_t set, VkPipelineBindPoint bindPoint);
+
         VTADevice& device;
         VkDescriptorSetLayout descriptorSetLayout;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayoutCreateFlags layoutFlags;
+
+        std::vector<VkDescriptorUpdateTemplateEntry> templateEntries; // sorted by binding, empty without template support
+        std::unordered_map<uint32_t, TemplateSlot> templateSlots;
+        uint32_t templateDescriptorCount = 0;
+        VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE; // for regular sets
+        std::vector<PushTemplate> pushTemplates;
+        std::mutex pushTemplateMutex; // several threads may record pushes with this layout
+
+        VkDeviceSize descriptorBufferSize = 0;
+        std::unordered_map<uint32_t, VkDeviceSize> descriptorBufferOffsets;
 
         friend class VTADescriptorWriter;
     };
@@ -47,41 +111,111 @@ namespace VTA {
     
     struct VTADescriptorAllocatorGrowable {
     public:
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4092;
+
         struct PoolSizeRatio {
             VkDescriptorType type;
             float ratio;
         };
 
-        void init(VkDevice device, uint32_t initialSets, std::span<PoolSizeRatio> poolRatios);
+        // counters since the last clear_pools, except highWaterMark and poolCount
+        struct Stats {
+            uint32_t setsAllocated = 0;
+            uint32_t poolsInUse = 0;
+            uint32_t poolCount = 0;     // every pool ever created, they are kept for reuse
+            uint32_t highWaterMark = 0; // most sets allocated between two clears
+        };
+
+        void init(VkDevice device, uint32_t initialSets, std::span<PoolSizeRatio> poolRatios, VkDescriptorPoolCreateFlags flags = 0);
         void clear_pools(VkDevice device);
         void destroy_pools(VkDevice device);
 
         VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext = nullptr);
+
+        Stats getStats() const;
     private:
         VkDescriptorPool get_pool(VkDevice device);
         VkDescriptorPool create_pool(VkDevice device, uint32_t setCount, std::span<PoolSizeRatio> poolRatios);
 
         std::vector<PoolSizeRatio> ratios;
         std::vector<VkDescriptorPool> fullPools;
-        std::vector<VkDescriptorPool> readyPools;
+        std::vector<VkDescriptorPool> readyPools; // back() is the pool allocations currently come from
         uint32_t setsPerPool;
+        VkDescriptorPoolCreateFlags poolFlags = 0;
 
+        uint32_t setsAllocated = 0;
+        uint32_t setsInCurrentPool = 0;
+        uint32_t highWaterMark = 0;
+
+    };
+
+    // One growable allocator per frame in flight, for sets that are only used by the frame that allocates them.
+    // beginFrame resets the slot of a frame whose fence was just waited on, so nothing is ever freed set by set.
+    class VTAFrameDescriptorAllocator {
+    public:
+        VTAFrameDescriptorAllocator(
+            VTADevice& device,
+            uint32_t framesInFlight,
+            uint32_t initialSets,
+            std::span<VTADescriptorAllocatorGrowable::PoolSizeRatio> poolRatios);
+        ~VTAFrameDescriptorAllocator();
+
+        VTAFrameDescriptorAllocator(const VTAFrameDescriptorAllocator&) = delete;
+        VTAFrameDescriptorAllocator& operator=(const VTAFrameDescriptorAllocator&) = delete;
+
+        // after the fence wait of frameIndex, everything it allocated last time around is released
+        void beginFrame(uint32_t frameIndex);
+
+        // thread safe, every thread recording the frame allocates from the same slot
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout, void* pNext = nullptr);
+
+        VTADescriptorAllocatorGrowable::Stats getStats(uint32_t frameIndex) const { return allocators[frameIndex].getStats(); }
+        uint32_t getCurrentFrame() const { return currentFrame; }
+
+    private:
+        VTADevice& device;
+        std::vector<VTADescriptorAllocatorGrowable> allocators;
+        uint32_t currentFrame = 0;
+        std::mutex mutex;
     };
 
 
 
+    // Layouts with an update template get their infos copied into packed data and written with a single
+    // vkUpdateDescriptorSetWithTemplate, nothing is allocated per write. Others keep a list of VkWriteDescriptorSet
+    // pointing at the caller's infos, those have to stay alive until overwrite or push.
     class VTADescriptorWriter {
     public:
         VTADescriptorWriter(VTADescriptorSetLayout& setLayout);
 
         VTADescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         VTADescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+        VTADescriptorWriter& writeImageArrayElement(uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo* imageInfo);
 
         void overwrite(VkDescriptorSet& set, VTADevice& device);
 
+        // binds the writes to `set` of pipelineLayout for the next draws or dispatches. push descriptor layouts record
+        // them straight into the command buffer, any other layout gets a set from fallbackAllocator that lives for the frame
+        void push(
+            VkCommandBuffer commandBuffer,
+            VkPipelineLayout pipelineLayout,
+            uint32_t set,
+            VTAFrameDescriptorAllocator* fallbackAllocator = nullptr,
+            VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+        // same as overwrite, for a set allocated from a descriptor buffer
+        void overwrite(VTADescriptorBuffer& descriptorBuffer, VkDeviceSize setOffset);
+
     private:
+        bool writeTemplateData(uint32_t binding, uint32_t arrayElement, const void* info, size_t infoSize);
+        bool templateDataComplete() const;
+        // plain writes for what has been written to the template data so far, returns the count
+        uint32_t templateWrites(std::array<VkWriteDescriptorSet, VTADescriptorSetLayout::MAX_TEMPLATE_DESCRIPTORS>& out) const;
+
         VTADescriptorSetLayout& setLayout;
-        std::vector<VkWriteDescriptorSet> writes;
+        std::vector<VkWriteDescriptorSet> writes; // only for layouts without an update template
+        alignas(8) std::array<std::byte, VTADescriptorSetLayout::MAX_TEMPLATE_DATA_SIZE> templateData;
+        uint64_t writtenDescriptors = 0; // one bit per descriptor of the template
     };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "VTA_device.hpp"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -54,9 +55,19 @@ VTADevice::VTADevice(VTAWindow &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  layoutCache_ = std::make_unique<VTALayoutCache>(device_);
+  pipelineCache_ = std::make_unique<VTAPipelineCache>(device_, properties, pipelineCacheFile);
+  shaderLibrary_ = std::make_unique<VTAShaderLibrary>(
+      device_,
+      inlineShaderCodeSupported,
+      getShaderModuleCreateInfoIdentifier);
 }
 
 VTADevice::~VTADevice() {
+  shaderLibrary_.reset();
+  pipelineCache_->save();
+  pipelineCache_.reset();
+  layoutCache_.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -93,7 +104,7 @@ void VTADevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_2; // 1.2 for vkGetPhysicalDeviceFeatures2 and the promoted extension structs
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -149,6 +160,215 @@ void VTADevice::pickPhysicalDevice() {
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
   msaaSamples = getMaxUsableSampleCount();
   std::cout << "physical device: " << properties.deviceName << std::endl;
+
+  queryOptionalFeatures();
+}
+
+void VTADevice::queryOptionalFeatures() {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      physicalDevice,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const char *optional : optionalDeviceExtensions) {
+    for (const auto &extension : availableExtensions) {
+      if (strcmp(optional, extension.extensionName) == 0) {
+        enabledOptionalExtensions.insert(optional);
+        break;
+      }
+    }
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+  VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+  bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+  indexingFeatures.pNext = &bufferDeviceAddressFeatures;
+
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{};
+  descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+    bufferDeviceAddressFeatures.pNext = &descriptorBufferFeatures;
+  }
+
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &indexingFeatures;
+
+  // pushed onto the front of the chain, and only when the extension is there to fill them in
+  VkPhysicalDeviceMaintenance5FeaturesKHR maintenance5Features{};
+  maintenance5Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_5_FEATURES_KHR;
+  if (hasDeviceExtension(VK_KHR_MAINTENANCE_5_EXTENSION_NAME)) {
+    maintenance5Features.pNext = features2.pNext;
+    features2.pNext = &maintenance5Features;
+  }
+  VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT cacheControlFeatures{};
+  cacheControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) {
+    cacheControlFeatures.pNext = features2.pNext;
+    features2.pNext = &cacheControlFeatures;
+  }
+  VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT identifierFeatures{};
+  identifierFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME)) {
+    identifierFeatures.pNext = features2.pNext;
+    features2.pNext = &identifierFeatures;
+  }
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  if (hasDeviceExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+    dynamicRenderingFeatures.pNext = features2.pNext;
+    features2.pNext = &dynamicRenderingFeatures;
+  }
+  VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+  synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  if (hasDeviceExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+    synchronization2Features.pNext = features2.pNext;
+    features2.pNext = &synchronization2Features;
+  }
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+  dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+    dynamicStateFeatures.pNext = features2.pNext;
+    features2.pNext = &dynamicStateFeatures;
+  }
+  VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features{};
+  dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+    dynamicState2Features.pNext = features2.pNext;
+    features2.pNext = &dynamicState2Features;
+  }
+  VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+  dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+  if (hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+    dynamicState3Features.pNext = features2.pNext;
+    features2.pNext = &dynamicState3Features;
+  }
+
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+  descriptorIndexingSupported = hasDeviceExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+                                indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                                indexingFeatures.descriptorBindingPartiallyBound &&
+                                indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                indexingFeatures.runtimeDescriptorArray;
+
+  if (descriptorIndexingSupported) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+    maxBindlessTextures = std::min({
+        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers});
+  }
+
+  VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+  subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 subgroupProperties2{};
+  subgroupProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  subgroupProperties2.pNext = &subgroupProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &subgroupProperties2);
+
+  subgroupQuadComputeSupported = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                                 (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) &&
+                                 subgroupProperties.subgroupSize >= 4;
+
+  pushDescriptorSupported = hasDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  if (pushDescriptorSupported) {
+    VkPhysicalDevicePushDescriptorPropertiesKHR pushDescriptorProperties{};
+    pushDescriptorProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PUSH_DESCRIPTOR_PROPERTIES_KHR;
+
+    VkPhysicalDeviceProperties2 pushProperties2{};
+    pushProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    pushProperties2.pNext = &pushDescriptorProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &pushProperties2);
+
+    maxPushDescriptors = pushDescriptorProperties.maxPushDescriptors;
+  }
+
+  descriptorBufferSupported = hasDeviceExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+                              hasDeviceExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) &&
+                              bufferDeviceAddressFeatures.bufferDeviceAddress &&
+                              descriptorBufferFeatures.descriptorBuffer;
+  if (descriptorBufferSupported) {
+    descriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 descriptorBufferProperties2{};
+    descriptorBufferProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    descriptorBufferProperties2.pNext = &descriptorBufferProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &descriptorBufferProperties2);
+  } else {
+    // its dependencies are not all there, don't enable it on its own
+    enabledOptionalExtensions.erase(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+  }
+
+  // the extension stays enabled without the feature, maintenance5 only needs it to be there
+  dynamicRenderingSupported = hasDeviceExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+                              dynamicRenderingFeatures.dynamicRendering;
+  // same here, descriptor buffers need the extension whether or not the feature is there
+  synchronization2Supported = hasDeviceExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) &&
+                              synchronization2Features.synchronization2;
+
+  extendedDynamicStateSupported = hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) &&
+                                  dynamicStateFeatures.extendedDynamicState;
+  extendedDynamicState2Supported = hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME) &&
+                                   dynamicState2Features.extendedDynamicState2;
+  dynamicBlendEnableSupported = hasDeviceExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME) &&
+                                dynamicState3Features.extendedDynamicState3ColorBlendEnable;
+  if (!extendedDynamicStateSupported) {
+    enabledOptionalExtensions.erase(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  }
+  if (!extendedDynamicState2Supported) {
+    enabledOptionalExtensions.erase(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+  }
+  if (!dynamicBlendEnableSupported) {
+    enabledOptionalExtensions.erase(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+  }
+
+  inlineShaderCodeSupported = hasDeviceExtension(VK_KHR_MAINTENANCE_5_EXTENSION_NAME) &&
+                              hasDeviceExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+                              maintenance5Features.maintenance5;
+  if (!inlineShaderCodeSupported) {
+    enabledOptionalExtensions.erase(VK_KHR_MAINTENANCE_5_EXTENSION_NAME);
+  }
+
+  // FAIL_ON_PIPELINE_COMPILE_REQUIRED comes from the cache control feature, identifiers are useless without it
+  shaderModuleIdentifierSupported = hasDeviceExtension(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) &&
+                                    hasDeviceExtension(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME) &&
+                                    identifierFeatures.shaderModuleIdentifier &&
+                                    cacheControlFeatures.pipelineCreationCacheControl;
+  if (!shaderModuleIdentifierSupported) {
+    enabledOptionalExtensions.erase(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+  }
+
+  // GPU driven draws carry the object index in firstInstance
+  multiDrawIndirectSupported = features2.features.multiDrawIndirect && features2.features.drawIndirectFirstInstance;
+  drawIndirectCountSupported = hasDeviceExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+  std::cout << "descriptor indexing: " << (descriptorIndexingSupported ? "yes" : "no") << std::endl;
+  std::cout << "push descriptors: " << (pushDescriptorSupported ? "yes" : "no") << std::endl;
+  std::cout << "descriptor buffers: " << (descriptorBufferSupported ? "yes" : "no") << std::endl;
+  std::cout << "dynamic rendering: " << (dynamicRenderingSupported ? "yes" : "no") << std::endl;
+  std::cout << "synchronization2: " << (synchronization2Supported ? "yes" : "no") << std::endl;
+  std::cout << "extended dynamic state: " << (extendedDynamicStateSupported ? "yes" : "no")
+            << (extendedDynamicState2Supported ? ", 2" : "") << (dynamicBlendEnableSupported ? ", 3 blend enable" : "") << std::endl;
+  std::cout << "inline shader code: " << (inlineShaderCodeSupported ? "yes" : "no") << std::endl;
+  std::cout << "shader module identifiers: " << (shaderModuleIdentifierSupported ? "yes" : "no") << std::endl;
+  std::cout << "multi draw indirect: " << (multiDrawIndirectSupported ? "yes" : "no")
+            << (drawIndirectCountSupported ? ", with count" : "") << std::endl;
 }
 
 void VTADevice::createLogicalDevice() {
@@ -167,18 +387,103 @@ void VTADevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
-  VkPhysicalDeviceFeatures deviceFeatures = {};
-  deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional features are chained through pNext, so the core ones go through VkPhysicalDeviceFeatures2 as well
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  if (descriptorIndexingSupported) {
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+  }
+
+  VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+  bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{};
+  descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+  if (descriptorBufferSupported) {
+    bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+    descriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+    indexingFeatures.pNext = &bufferDeviceAddressFeatures;
+    bufferDeviceAddressFeatures.pNext = &descriptorBufferFeatures;
+  }
+
+  VkPhysicalDeviceFeatures2 deviceFeatures{};
+  deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  deviceFeatures.pNext = &indexingFeatures;
+  deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.features.multiDrawIndirect = multiDrawIndirectSupported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.features.drawIndirectFirstInstance = multiDrawIndirectSupported ? VK_TRUE : VK_FALSE;
+
+  VkPhysicalDeviceMaintenance5FeaturesKHR maintenance5Features{};
+  maintenance5Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_5_FEATURES_KHR;
+  if (inlineShaderCodeSupported) {
+    maintenance5Features.maintenance5 = VK_TRUE;
+    maintenance5Features.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &maintenance5Features;
+  }
+  VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT cacheControlFeatures{};
+  cacheControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT;
+  VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT identifierFeatures{};
+  identifierFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+  if (shaderModuleIdentifierSupported) {
+    cacheControlFeatures.pipelineCreationCacheControl = VK_TRUE;
+    identifierFeatures.shaderModuleIdentifier = VK_TRUE;
+    identifierFeatures.pNext = &cacheControlFeatures;
+    cacheControlFeatures.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &identifierFeatures;
+  }
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  if (dynamicRenderingSupported) {
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    dynamicRenderingFeatures.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &dynamicRenderingFeatures;
+  }
+  VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+  synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  if (synchronization2Supported) {
+    synchronization2Features.synchronization2 = VK_TRUE;
+    synchronization2Features.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &synchronization2Features;
+  }
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+  dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  if (extendedDynamicStateSupported) {
+    dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    dynamicStateFeatures.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &dynamicStateFeatures;
+  }
+  VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features{};
+  dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+  if (extendedDynamicState2Supported) {
+    dynamicState2Features.extendedDynamicState2 = VK_TRUE;
+    dynamicState2Features.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &dynamicState2Features;
+  }
+  VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+  dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+  if (dynamicBlendEnableSupported) {
+    dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+    dynamicState3Features.pNext = deviceFeatures.pNext;
+    deviceFeatures.pNext = &dynamicState3Features;
+  }
+
+  std::vector<const char *> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  for (const auto &extension : enabledOptionalExtensions) {
+    enabledExtensions.push_back(extension.c_str());
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &deviceFeatures;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-  createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.pEnabledFeatures = nullptr; // provided through deviceFeatures in pNext
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -195,6 +500,81 @@ void VTADevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  if (pushDescriptorSupported) {
+    cmdPushDescriptorSet = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdPushDescriptorSetKHR");
+    pushDescriptorSupported = cmdPushDescriptorSet != nullptr;
+    cmdPushDescriptorSetWithTemplate = (PFN_vkCmdPushDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdPushDescriptorSetWithTemplateKHR");
+  }
+
+  if (descriptorBufferSupported) {
+    getDescriptorSetLayoutSize = (PFN_vkGetDescriptorSetLayoutSizeEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkGetDescriptorSetLayoutSizeEXT");
+    getDescriptorSetLayoutBindingOffset = (PFN_vkGetDescriptorSetLayoutBindingOffsetEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkGetDescriptorSetLayoutBindingOffsetEXT");
+    getDescriptor = (PFN_vkGetDescriptorEXT)vkGetDeviceProcAddr(device_, "vkGetDescriptorEXT");
+    cmdBindDescriptorBuffers = (PFN_vkCmdBindDescriptorBuffersEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdBindDescriptorBuffersEXT");
+    cmdSetDescriptorBufferOffsets = (PFN_vkCmdSetDescriptorBufferOffsetsEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdSetDescriptorBufferOffsetsEXT");
+  }
+
+  if (shaderModuleIdentifierSupported) {
+    getShaderModuleCreateInfoIdentifier = (PFN_vkGetShaderModuleCreateInfoIdentifierEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkGetShaderModuleCreateInfoIdentifierEXT");
+    shaderModuleIdentifierSupported = getShaderModuleCreateInfoIdentifier != nullptr;
+  }
+
+  if (dynamicRenderingSupported) {
+    cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR");
+    cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR");
+    dynamicRenderingSupported = cmdBeginRendering != nullptr && cmdEndRendering != nullptr;
+  }
+
+  if (synchronization2Supported) {
+    cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device_, "vkCmdPipelineBarrier2KHR");
+    synchronization2Supported = cmdPipelineBarrier2 != nullptr;
+  }
+
+  if (extendedDynamicStateSupported) {
+    cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT");
+    cmdSetFrontFace = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device_, "vkCmdSetFrontFaceEXT");
+    cmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device_, "vkCmdSetPrimitiveTopologyEXT");
+    cmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthTestEnableEXT");
+    cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthWriteEnableEXT");
+    cmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthCompareOpEXT");
+    extendedDynamicStateSupported = cmdSetCullMode && cmdSetFrontFace && cmdSetPrimitiveTopology &&
+                                    cmdSetDepthTestEnable && cmdSetDepthWriteEnable && cmdSetDepthCompareOp;
+  }
+
+  if (extendedDynamicState2Supported) {
+    cmdSetDepthBiasEnable = (PFN_vkCmdSetDepthBiasEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthBiasEnableEXT");
+    cmdSetPrimitiveRestartEnable = (PFN_vkCmdSetPrimitiveRestartEnableEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdSetPrimitiveRestartEnableEXT");
+    extendedDynamicState2Supported = cmdSetDepthBiasEnable && cmdSetPrimitiveRestartEnable;
+  }
+
+  if (dynamicBlendEnableSupported) {
+    cmdSetColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(device_, "vkCmdSetColorBlendEnableEXT");
+    dynamicBlendEnableSupported = cmdSetColorBlendEnable != nullptr;
+  }
+
+  if (drawIndirectCountSupported) {
+    cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdDrawIndexedIndirectCountKHR");
+    drawIndirectCountSupported = cmdDrawIndexedIndirectCount != nullptr;
+  }
 }
 
 void VTADevice::createCommandPool() {
@@ -445,6 +825,14 @@ void VTADevice::createBuffer(
   allocInfo.allocationSize = memRequirements.size;
   allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
+  // buffers whose address gets taken need memory allocated for it
+  VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+  allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+  allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+  if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+    allocInfo.pNext = &allocFlagsInfo;
+  }
+
   if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate vertex buffer memory!");
   }
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "VTA_Window.h"
+#include "VTA_layout_cache.h"
+#include "VTA_pipeline_cache.h"
+#include "VTA_shader_library.h"
 
 // std lib headers
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace VTA {
@@ -44,6 +49,9 @@ class VTADevice {
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VTALayoutCache &layoutCache() { return *layoutCache_; }
+  VTAPipelineCache &pipelineCache() { return *pipelineCache_; }
+  VTAShaderLibrary &shaderLibrary() { return *shaderLibrary_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -70,8 +78,53 @@ class VTADevice {
       VkImage &image,
       VkDeviceMemory &imageMemory);
 
+  bool hasDeviceExtension(const char *extensionName) const {
+    return enabledOptionalExtensions.count(extensionName) > 0;
+  }
+
   VkPhysicalDeviceProperties properties;
 
+  // optional features, filled in while picking the physical device
+  bool descriptorIndexingSupported = false;  // partially bound, update-after-bind sampled image arrays
+  uint32_t maxBindlessTextures = 0;  // smallest of the update-after-bind sampler / sampled image limits
+  bool subgroupQuadComputeSupported = false;  // quad swaps in compute shaders
+  bool pushDescriptorSupported = false;  // VK_KHR_push_descriptor
+  uint32_t maxPushDescriptors = 0;
+  bool descriptorBufferSupported = false;  // VK_EXT_descriptor_buffer, buffer device addresses come with it
+  VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties{};
+  bool dynamicRenderingSupported = false;  // VK_KHR_dynamic_rendering, passes without render pass and framebuffer objects
+  bool synchronization2Supported = false;  // VK_KHR_synchronization2, 64 bit stage and access masks in one barrier call
+  bool extendedDynamicStateSupported = false;  // VK_EXT_extended_dynamic_state: cull mode, front face, topology, depth test
+  bool extendedDynamicState2Supported = false;  // VK_EXT_extended_dynamic_state2: depth bias and primitive restart enable
+  bool dynamicBlendEnableSupported = false;  // VK_EXT_extended_dynamic_state3 colorBlendEnable
+  bool inlineShaderCodeSupported = false;  // VK_KHR_maintenance5, pipelines take SPIR-V without a shader module
+  bool shaderModuleIdentifierSupported = false;  // VK_EXT_shader_module_identifier
+  bool multiDrawIndirectSupported = false;  // multiDrawIndirect and drawIndirectFirstInstance, many draws from one buffer
+  bool drawIndirectCountSupported = false;  // VK_KHR_draw_indirect_count, the draw count comes from a buffer too
+
+  // extension entry points, loaded after device creation when the extension is enabled
+  PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet = nullptr;
+  PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate = nullptr;  // may stay null, push then falls back to plain writes
+  PFN_vkGetDescriptorSetLayoutSizeEXT getDescriptorSetLayoutSize = nullptr;
+  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT getDescriptorSetLayoutBindingOffset = nullptr;
+  PFN_vkGetDescriptorEXT getDescriptor = nullptr;
+  PFN_vkCmdBindDescriptorBuffersEXT cmdBindDescriptorBuffers = nullptr;
+  PFN_vkCmdSetDescriptorBufferOffsetsEXT cmdSetDescriptorBufferOffsets = nullptr;
+  PFN_vkGetShaderModuleCreateInfoIdentifierEXT getShaderModuleCreateInfoIdentifier = nullptr;
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+  PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2 = nullptr;
+  PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+  PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
+  PFN_vkCmdSetDepthBiasEnableEXT cmdSetDepthBiasEnable = nullptr;
+  PFN_vkCmdSetPrimitiveRestartEnableEXT cmdSetPrimitiveRestartEnable = nullptr;
+  PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable = nullptr;
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
   VkSampleCountFlagBits msaaSamples; // for multisample anti-aliasing
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VkSampleCountFlagBits getMaxUsableSampleCount();
@@ -93,6 +146,7 @@ class VTADevice {
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+  void queryOptionalFeatures();
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
@@ -104,9 +158,29 @@ class VTADevice {
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  std::unique_ptr<VTALayoutCache> layoutCache_;  // shared set and pipeline layouts, destroyed before the device
+  std::unique_ptr<VTAPipelineCache> pipelineCache_;  // loaded at startup, saved back on shutdown
+  std::unique_ptr<VTAShaderLibrary> shaderLibrary_;  // mapped SPIR-V shared by every pipeline
+
+  const char *pipelineCacheFile = "pipeline_cache.bin";
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // enabled only when the physical device supports them
+  const std::vector<const char *> optionalDeviceExtensions = {
+      VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+      VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+      VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,  // required by VK_EXT_descriptor_buffer on 1.2
+      VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME,
+      VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,  // also required by VK_KHR_maintenance5 on 1.2
+      VK_KHR_MAINTENANCE_5_EXTENSION_NAME,
+      VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME,  // required by VK_EXT_shader_module_identifier on 1.2
+      VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME,
+      VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME,
+      VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME,
+      VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME,
+      VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
+  std::unordered_set<std::string> enabledOptionalExtensions;
 };
 
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "VTA_draw_list.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <stdexcept>
+
+namespace VTA
+{
+	static constexpr uint32_t RADIX_BITS = 8;
+	static constexpr uint32_t BUCKET_COUNT = 1u << RADIX_BITS;
+	static constexpr uint32_t DIGIT_COUNT = 64 / RADIX_BITS;
+	static constexpr size_t MIN_ITEMS_PER_CHUNK = 4096; // below that handing a chunk to a worker costs more than sorting it
+
+	uint64_t DrawKey::make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		assert(pass < (1u << PASS_BITS) && pipeline < (1u << PIPELINE_BITS) && "Id doesn't fit its field");
+		assert(material < (1u << MATERIAL_BITS) && mesh < (1u << MESH_BITS) && "Id doesn't fit its field");
+
+		constexpr uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+		uint64_t quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * maxDepth);
+
+		uint64_t key = pass;
+		key = (key << PIPELINE_BITS) | pipeline;
+		key = (key << MATERIAL_BITS) | material;
+		key = (key << MESH_BITS) | mesh;
+		key = (key << DEPTH_BITS) | quantizedDepth;
+		return key;
+	}
+
+	void VTADrawList::radixSort(std::vector<Item>& items, std::vector<Item>& scratch, VTAThreadPool* threadPool)
+	{
+		size_t count = items.size();
+		if (count < 2) return;
+		scratch.resize(count);
+
+		uint32_t chunkCount = 1;
+		if (threadPool)
+		{
+			chunkCount = static_cast<uint32_t>(std::clamp<size_t>(count / MIN_ITEMS_PER_CHUNK, 1, threadPool->getThreadCount() + 1));
+		}
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		auto forEachChunk = [&](const std::function<void(size_t begin, size_t end, uint32_t chunk)>& task)
+		{
+			auto run = [&](uint32_t chunk) { task(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize), chunk); };
+			if (chunkCount == 1)
+			{
+				run(0);
+				return;
+			}
+			threadPool->parallelFor(chunkCount, run);
+		};
+
+		// bits that differ from the first key somewhere, a digit without any moves nothing and its pass is skipped
+		std::vector<uint64_t> chunkDiffering(chunkCount, 0);
+		forEachChunk([&](size_t begin, size_t end, uint32_t chunk)
+			{
+				uint64_t first = items[0].key;
+				uint64_t differing = 0;
+				for (size_t i = begin; i < end; i++) differing |= items[i].key ^ first;
+				chunkDiffering[chunk] = differing;
+			});
+		uint64_t differing = 0;
+		for (uint64_t chunk : chunkDiffering) differing |= chunk;
+
+		// counts of a chunk, turned into where its items of each bucket go. Stable because chunks and the items
+		// within them are scattered in order
+		std::vector<std::array<uint32_t, BUCKET_COUNT>> offsets(chunkCount);
+		for (uint32_t digit = 0; digit < DIGIT_COUNT; digit++)
+		{
+			uint32_t shift = digit * RADIX_BITS;
+			if (((differing >> shift) & (BUCKET_COUNT - 1)) == 0) continue;
+
+			forEachChunk([&](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& counts = offsets[chunk];
+					counts.fill(0);
+					for (size_t i = begin; i < end; i++) counts[(items[i].key >> shift) & (BUCKET_COUNT - 1)]++;
+				});
+
+			uint32_t offset = 0;
+			for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+			{
+				for (auto& chunkOffsets : offsets)
+				{
+					uint32_t bucketCount = chunkOffsets[bucket];
+					chunkOffsets[bucket] = offset;
+					offset += bucketCount;
+				}
+			}
+
+			forEachChunk([&](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& chunkOffsets = offsets[chunk];
+					for (size_t i = begin; i < end; i++) scratch[chunkOffsets[(items[i].key >> shift) & (BUCKET_COUNT - 1)]++] = items[i];
+				});
+			items.swap(scratch);
+		}
+	}
+
+	VTADrawList::BenchmarkResult VTADrawList::benchmark(VTAThreadPool& threadPool, uint32_t itemCount, uint32_t iterations)
+	{
+		std::mt19937_64 random{ 1234 }; // the same keys every run, so runs compare
+		std::vector<Item> input(itemCount);
+		for (uint32_t i = 0; i < itemCount; i++)
+		{
+			input[i] = Item{ random(), i };
+		}
+
+		std::vector<Item> items;
+		std::vector<Item> scratch;
+		auto time = [&](const std::function<void()>& sort)
+		{
+			double best = 0.0;
+			for (uint32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				items = input;
+				auto start = std::chrono::high_resolution_clock::now();
+				sort();
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				best = iteration == 0 ? ms : std::min(best, ms);
+			}
+			return best;
+		};
+
+		BenchmarkResult result{};
+		result.itemCount = itemCount;
+		result.stdSortMs = time([&]
+			{
+				std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.key < b.key; });
+			});
+		std::vector<Item> expected = items;
+
+		result.radixSortMs = time([&] { radixSort(items, scratch, nullptr); });
+		bool radixMatches = std::equal(items.begin(), items.end(), expected.begin(), [](const Item& a, const Item& b) { return a.key == b.key && a.index == b.index; });
+		result.parallelRadixSortMs = time([&] { radixSort(items, scratch, &threadPool); });
+		bool parallelMatches = std::equal(items.begin(), items.end(), expected.begin(), [](const Item& a, const Item& b) { return a.key == b.key && a.index == b.index; });
+
+		if (!radixMatches || !parallelMatches)
+		{
+			throw std::runtime_error("radix sort doesn't match std::stable_sort!");
+		}
+		return result;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VTA_thread_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace VTA
+{
+	// 64 bit draw sort key, most significant field first. Sorting by it keeps draws that share a pass, pipeline,
+	// material and mesh next to each other, and orders each run of the same state front to back for early depth rejection
+	namespace DrawKey
+	{
+		constexpr uint32_t PASS_BITS = 4;
+		constexpr uint32_t PIPELINE_BITS = 10;
+		constexpr uint32_t MATERIAL_BITS = 16;
+		constexpr uint32_t MESH_BITS = 16;
+		constexpr uint32_t DEPTH_BITS = 18;
+		static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64, "The fields fill the key");
+
+		// depth is clip space depth in [0, 1], anything outside is clamped. Ids have to fit their field
+		uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+		// everything but the depth, draws with the same state can be merged
+		constexpr uint64_t state(uint64_t key) { return key >> DEPTH_BITS; }
+		constexpr uint32_t mesh(uint64_t key) { return static_cast<uint32_t>((key >> DEPTH_BITS) & ((1u << MESH_BITS) - 1)); }
+		constexpr uint32_t material(uint64_t key) { return static_cast<uint32_t>((key >> (DEPTH_BITS + MESH_BITS)) & ((1u << MATERIAL_BITS) - 1)); }
+	}
+
+	// Keys and whatever the caller draws from them, sorted with an LSD radix sort. Above a few thousand items the
+	// histogram and scatter of each digit are split over the thread pool, passes over digits that every key agrees
+	// on are skipped. The storage is kept between frames, so a frame that doesn't grow the list allocates nothing.
+	class VTADrawList
+	{
+	public:
+		struct Item
+		{
+			uint64_t key;
+			uint32_t index; // the caller's, e.g. into its list of objects
+		};
+
+		explicit VTADrawList(VTAThreadPool* threadPool = nullptr) : threadPool{ threadPool } {}
+
+		void clear() { items.clear(); }
+		void add(uint64_t key, uint32_t index) { items.push_back(Item{ key, index }); }
+
+		// stable, items with equal keys stay in the order they were added
+		void sort() { radixSort(items, scratch, threadPool); }
+
+		const std::vector<Item>& getItems() const { return items; }
+		size_t size() const { return items.size(); }
+
+		// the sort behind sort(), items ends up sorted and scratch holds garbage. threadPool can be null
+		static void radixSort(std::vector<Item>& items, std::vector<Item>& scratch, VTAThreadPool* threadPool);
+
+		struct BenchmarkResult
+		{
+			uint32_t itemCount = 0;
+			double stdSortMs = 0.0;        // std::stable_sort, the comparison sort with the same guarantee
+			double radixSortMs = 0.0;      // on the calling thread only
+			double parallelRadixSortMs = 0.0;
+		};
+		// best of iterations on itemCount random keys. Random keys differ in every digit, so this is the slowest case,
+		// real keys share their upper fields and skip those passes
+		static BenchmarkResult benchmark(VTAThreadPool& threadPool, uint32_t itemCount = 100000, uint32_t iterations = 10);
+
+	private:
+		VTAThreadPool* threadPool;
+		std::vector<Item> items;
+		std::vector<Item> scratch;
+	};
+}
@@ -0,0 +1,464 @@
+#include "VTA_frame_graph.h"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace VTA
+{
+	namespace
+	{
+		struct UsageInfo
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags2KHR stages;
+			VkAccessFlags2KHR readAccess;  // attachments are read too, by the load op and depth test
+			VkAccessFlags2KHR writeAccess; // 0 for usages that can't write
+		};
+
+		UsageInfo usageInfo(FrameGraphUsage usage)
+		{
+			constexpr VkPipelineStageFlags2KHR fragmentTests =
+				VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+
+			switch (usage)
+			{
+			case FrameGraphUsage::ColorAttachment:
+				return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+					VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR };
+			case FrameGraphUsage::DepthAttachment:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, fragmentTests,
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR };
+			case FrameGraphUsage::DepthReadOnly:
+				return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, fragmentTests,
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, 0 };
+			case FrameGraphUsage::FragmentSampled:
+				return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+					VK_ACCESS_2_SHADER_READ_BIT_KHR, 0 };
+			case FrameGraphUsage::ComputeSampled:
+				return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+					VK_ACCESS_2_SHADER_READ_BIT_KHR, 0 };
+			case FrameGraphUsage::ComputeStorage:
+				return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+					VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR };
+			case FrameGraphUsage::TransferSource:
+				return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+					VK_ACCESS_2_TRANSFER_READ_BIT_KHR, 0 };
+			case FrameGraphUsage::TransferDestination:
+				return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+					0, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR };
+			case FrameGraphUsage::IndirectCommand:
+				return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+					VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, 0 };
+			case FrameGraphUsage::VertexStorage:
+				return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR,
+					VK_ACCESS_2_SHADER_READ_BIT_KHR, 0 };
+			}
+			throw std::runtime_error("unknown frame graph usage!");
+		}
+
+		bool isBufferOnly(FrameGraphUsage usage)
+		{
+			return usage == FrameGraphUsage::IndirectCommand || usage == FrameGraphUsage::VertexStorage;
+		}
+
+		bool isImageOnly(FrameGraphUsage usage)
+		{
+			return usage == FrameGraphUsage::ColorAttachment || usage == FrameGraphUsage::DepthAttachment ||
+				usage == FrameGraphUsage::DepthReadOnly || usage == FrameGraphUsage::FragmentSampled ||
+				usage == FrameGraphUsage::ComputeSampled;
+		}
+	}
+
+	// *************** Pass Builder *********************
+
+	void VTAFrameGraph::PassBuilder::read(Resource resource, FrameGraphUsage usage)
+	{
+		if (resource >= graph.resources.size())
+		{
+			throw std::runtime_error("failed to read frame graph resource, it doesn't exist!");
+		}
+		if (usage == FrameGraphUsage::TransferDestination)
+		{
+			throw std::runtime_error("failed to read " + graph.resources[resource].name + ", transfer destinations are write only!");
+		}
+		graph.checkUsage(resource, usage, pass);
+
+		auto& usages = graph.passes[pass].usages;
+		auto existing = std::find_if(usages.begin(), usages.end(), [&](const Usage& u) { return u.resource == resource; });
+		if (existing == usages.end())
+		{
+			usages.push_back(Usage{ resource, usage, false, false });
+		}
+		else if (existing->usage != usage)
+		{
+			// one image can only be in one layout during a pass, and a buffer only gets one barrier in front of it
+			throw std::runtime_error("failed to add " + graph.resources[resource].name + " to " + graph.passes[pass].name + ", it is already used differently!");
+		}
+		else
+		{
+			existing->discard = false; // the pass reads what was there before
+		}
+	}
+
+	void VTAFrameGraph::PassBuilder::write(Resource resource, FrameGraphUsage usage, bool discard)
+	{
+		if (resource >= graph.resources.size())
+		{
+			throw std::runtime_error("failed to write frame graph resource, it doesn't exist!");
+		}
+		if (usageInfo(usage).writeAccess == 0)
+		{
+			throw std::runtime_error("failed to write " + graph.resources[resource].name + ", the usage is read only!");
+		}
+		graph.checkUsage(resource, usage, pass);
+
+		auto& usages = graph.passes[pass].usages;
+		auto existing = std::find_if(usages.begin(), usages.end(), [&](const Usage& u) { return u.resource == resource; });
+		if (existing == usages.end())
+		{
+			usages.push_back(Usage{ resource, usage, true, discard });
+		}
+		else if (existing->usage != usage)
+		{
+			throw std::runtime_error("failed to add " + graph.resources[resource].name + " to " + graph.passes[pass].name + ", it is already used differently!");
+		}
+		else
+		{
+			existing->discard = existing->write ? existing->discard && discard : false;
+			existing->write = true;
+		}
+	}
+
+	void VTAFrameGraph::PassBuilder::hasSideEffects()
+	{
+		graph.passes[pass].sideEffects = true;
+	}
+
+	// *************** Frame Graph *********************
+
+	void VTAFrameGraph::checkUsage(Resource resource, FrameGraphUsage usage, uint32_t pass) const
+	{
+		const auto& node = resources[resource];
+		if (node.externallySynchronized) return;
+		if (node.isBuffer ? isImageOnly(usage) : isBufferOnly(usage))
+		{
+			throw std::runtime_error("failed to add " + node.name + " to " + passes[pass].name + ", the usage doesn't fit " +
+				(node.isBuffer ? "a buffer!" : "an image!"));
+		}
+	}
+
+	void VTAFrameGraph::reset()
+	{
+		passes.clear();
+		resources.clear();
+		compiled = false;
+	}
+
+	VTAFrameGraph::Resource VTAFrameGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+		VkImageAspectFlags aspect, VkImageLayout layout, VkImageLayout finalLayout)
+	{
+		ResourceNode node{};
+		node.name = name;
+		node.image = image;
+		node.view = view;
+		node.aspect = aspect;
+		node.initialLayout = layout;
+		node.finalLayout = finalLayout;
+		resources.push_back(node);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	VTAFrameGraph::Resource VTAFrameGraph::importExternallySynchronized(const std::string& name)
+	{
+		ResourceNode node{};
+		node.name = name;
+		node.externallySynchronized = true;
+		resources.push_back(node);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	VTAFrameGraph::Resource VTAFrameGraph::importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+	{
+		ResourceNode node{};
+		node.name = name;
+		node.isBuffer = true;
+		node.buffer = buffer;
+		node.bufferOffset = offset;
+		node.bufferSize = size;
+		resources.push_back(node);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	void VTAFrameGraph::addPass(const std::string& name, const Setup& setup, Execute execute)
+	{
+		if (compiled)
+		{
+			throw std::runtime_error("failed to add pass " + name + ", the frame graph is already compiled!");
+		}
+		Pass pass{};
+		pass.name = name;
+		pass.execute = std::move(execute);
+		passes.push_back(std::move(pass));
+		PassBuilder builder{ *this, static_cast<uint32_t>(passes.size() - 1) };
+		setup(builder);
+	}
+
+	VkImage VTAFrameGraph::getImage(Resource resource) const
+	{
+		return resources.at(resource).image;
+	}
+
+	VkImageView VTAFrameGraph::getImageView(Resource resource) const
+	{
+		return resources.at(resource).view;
+	}
+
+	VkBuffer VTAFrameGraph::getBuffer(Resource resource) const
+	{
+		return resources.at(resource).buffer;
+	}
+
+	void VTAFrameGraph::compile()
+	{
+		cullPasses();
+		compiled = true;
+	}
+
+	void VTAFrameGraph::cullPasses()
+	{
+		// walk back from the end of the frame, where every resource is needed, a pass survives when something still
+		// needed is written by it. Passes can only read what earlier passes wrote, so one sweep finds all of them
+		std::vector<bool> needed(resources.size(), true);
+
+		stats.passesCulled = 0;
+		for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+		{
+			pass->culled = !pass->sideEffects && std::none_of(pass->usages.begin(), pass->usages.end(), [&](const Usage& u) {
+				return u.write && needed[u.resource];
+				});
+			if (pass->culled)
+			{
+				stats.passesCulled++;
+				continue;
+			}
+
+			for (const Usage& u : pass->usages)
+			{
+				resources[u.resource].used = true;
+				if (!u.write)
+				{
+					needed[u.resource] = true;
+				}
+				else if (u.discard && !resources[u.resource].externallySynchronized)
+				{
+					needed[u.resource] = false; // earlier writes are overwritten before anyone reads them
+				}
+				// a plain write loads what was there, so earlier writers stay needed
+			}
+		}
+	}
+
+	void VTAFrameGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		if (!compiled)
+		{
+			throw std::runtime_error("failed to execute frame graph, it isn't compiled!");
+		}
+
+		std::vector<ResourceState> states(resources.size());
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			// nothing is known about what happened to an imported resource before the graph
+			states[i].layout = resources[i].initialLayout;
+			states[i].writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+			states[i].writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+		}
+
+		stats.barriers = 0;
+		for (uint32_t i = 0; i < passes.size(); i++)
+		{
+			if (passes[i].culled) continue;
+			recordBarriers(commandBuffer, i, states);
+			passes[i].execute(commandBuffer);
+		}
+
+		// hand the imported images back in the layout they were promised in
+		std::vector<VkImageMemoryBarrier2KHR> barriers;
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const auto& node = resources[i];
+			if (node.externallySynchronized || node.isBuffer || !node.used) continue;
+			if (states[i].layout == node.finalLayout) continue;
+
+			VkImageMemoryBarrier2KHR barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+			barrier.srcStageMask = states[i].writeStages | states[i].readStages;
+			barrier.srcAccessMask = states[i].writeAccess;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+			barrier.oldLayout = states[i].layout;
+			barrier.newLayout = node.finalLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = node.image;
+			barrier.subresourceRange = { node.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			barriers.push_back(barrier);
+		}
+		submitBarriers(commandBuffer, barriers);
+	}
+
+	void VTAFrameGraph::recordBarriers(VkCommandBuffer commandBuffer, uint32_t passIndex, std::vector<ResourceState>& states)
+	{
+		std::vector<VkImageMemoryBarrier2KHR> barriers;
+		std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+		for (const Usage& u : passes[passIndex].usages)
+		{
+			auto& node = resources[u.resource];
+			if (node.externallySynchronized) continue;
+
+			UsageInfo info = usageInfo(u.usage);
+			if (node.isBuffer) info.layout = VK_IMAGE_LAYOUT_UNDEFINED; // no layouts, never a transition
+			VkAccessFlags2KHR dstAccess = info.readAccess | (u.write ? info.writeAccess : 0);
+			ResourceState& state = states[u.resource];
+
+			VkImageMemoryBarrier2KHR barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+			barrier.dstStageMask = info.stages;
+			barrier.dstAccessMask = dstAccess;
+			barrier.newLayout = info.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = node.image;
+			barrier.subresourceRange = { node.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+			bool needed = true;
+			if (state.layout != info.layout || (u.write && u.discard))
+			{
+				barrier.srcStageMask = state.writeStages | state.readStages;
+				barrier.srcAccessMask = state.writeAccess;
+				barrier.oldLayout = u.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+			}
+			else if (!u.write)
+			{
+				// read after read needs nothing, read after write only if this stage doesn't see the write yet
+				needed = state.writeStages != 0 &&
+					((info.stages & ~state.readStages) != 0 || (dstAccess & ~state.readAccess) != 0);
+				barrier.srcStageMask = state.writeStages;
+				barrier.srcAccessMask = state.writeAccess;
+				barrier.oldLayout = state.layout;
+			}
+			else
+			{
+				// write after read only waits for the readers, write after write also flushes the earlier write
+				needed = (state.writeStages | state.readStages) != 0;
+				barrier.srcStageMask = state.writeStages | state.readStages;
+				barrier.srcAccessMask = state.writeAccess;
+				barrier.oldLayout = state.layout;
+			}
+
+			bool transition = barrier.oldLayout != barrier.newLayout;
+			if (needed && node.isBuffer)
+			{
+				VkBufferMemoryBarrier2KHR bufferBarrier{};
+				bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+				bufferBarrier.srcStageMask = barrier.srcStageMask;
+				bufferBarrier.srcAccessMask = barrier.srcAccessMask;
+				bufferBarrier.dstStageMask = barrier.dstStageMask;
+				bufferBarrier.dstAccessMask = barrier.dstAccessMask;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = node.buffer;
+				bufferBarrier.offset = node.bufferOffset;
+				bufferBarrier.size = node.bufferSize;
+				bufferBarriers.push_back(bufferBarrier);
+			}
+			else if (needed)
+			{
+				barriers.push_back(barrier);
+			}
+
+			if (u.write)
+			{
+				state.writeStages = info.stages;
+				state.writeAccess = info.writeAccess;
+				state.readStages = 0;
+				state.readAccess = 0;
+			}
+			else if (transition)
+			{
+				// later readers chain their wait through this one, which comes after the transition
+				state.writeStages = info.stages;
+				state.readStages = info.stages;
+				state.readAccess = dstAccess;
+			}
+			else
+			{
+				state.readStages |= info.stages;
+				state.readAccess |= dstAccess;
+			}
+			state.layout = info.layout;
+		}
+
+		submitBarriers(commandBuffer, barriers, bufferBarriers);
+	}
+
+	void VTAFrameGraph::submitBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2KHR>& barriers,
+		const std::vector<VkBufferMemoryBarrier2KHR>& bufferBarriers)
+	{
+		if (barriers.empty() && bufferBarriers.empty()) return;
+		stats.barriers += static_cast<uint32_t>(barriers.size() + bufferBarriers.size());
+
+		if (device.synchronization2Supported)
+		{
+			VkDependencyInfoKHR dependency{};
+			dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+			dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+			dependency.pBufferMemoryBarriers = bufferBarriers.data();
+			dependency.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+			dependency.pImageMemoryBarriers = barriers.data();
+			device.cmdPipelineBarrier2(commandBuffer, &dependency);
+			return;
+		}
+
+		// the legacy call takes one pair of stage masks for the whole batch, the access bits mean the same below bit 32
+		std::vector<VkImageMemoryBarrier> legacy;
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		for (const auto& barrier : barriers)
+		{
+			VkImageMemoryBarrier old{};
+			old.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			old.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+			old.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+			old.oldLayout = barrier.oldLayout;
+			old.newLayout = barrier.newLayout;
+			old.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			old.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			old.image = barrier.image;
+			old.subresourceRange = barrier.subresourceRange;
+			legacy.push_back(old);
+			srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+		}
+		std::vector<VkBufferMemoryBarrier> legacyBuffers;
+		for (const auto& barrier : bufferBarriers)
+		{
+			VkBufferMemoryBarrier old{};
+			old.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			old.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+			old.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+			old.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			old.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			old.buffer = barrier.buffer;
+			old.offset = barrier.offset;
+			old.size = barrier.size;
+			legacyBuffers.push_back(old);
+			srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+		}
+		vkCmdPipelineBarrier(commandBuffer, srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages,
+			0, 0, nullptr, static_cast<uint32_t>(legacyBuffers.size()), legacyBuffers.data(),
+			static_cast<uint32_t>(legacy.size()), legacy.data());
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "VTA_device.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VTA
+{
+	// how a pass touches a resource, decides the layout, stages and access of the barriers in front of it
+	enum class FrameGraphUsage
+	{
+		ColorAttachment,
+		DepthAttachment,
+		DepthReadOnly,    // depth test without depth writes
+		FragmentSampled,
+		ComputeSampled,
+		ComputeStorage,   // storage image or storage buffer
+		TransferSource,
+		TransferDestination,
+		IndirectCommand,  // buffers only, draw or dispatch parameters
+		VertexStorage,    // buffers only, a storage buffer the vertex shader reads
+	};
+
+	// Passes declare which images and buffers they read and write, the graph works out the rest every frame:
+	// compile() drops the passes nothing outside the graph depends on, and execute() records the passes in the order
+	// they were added with the smallest set of barriers in front of each one, batched into one vkCmdPipelineBarrier2
+	// per pass (vkCmdPipelineBarrier without VK_KHR_synchronization2). Buffers get the same barriers as images minus
+	// the layouts. Every resource is imported, the graph owns no memory; depth and MSAA colour still belong to the
+	// swap chain, whose render pass handles them.
+	// The graph is declared again every frame, from reset() to execute().
+	class VTAFrameGraph
+	{
+	public:
+		using Resource = uint32_t;
+
+		class PassBuilder
+		{
+		public:
+			void read(Resource resource, FrameGraphUsage usage);
+			// discard: the pass overwrites the whole resource, what earlier passes wrote into it isn't needed
+			void write(Resource resource, FrameGraphUsage usage, bool discard = false);
+			// the pass has an effect outside the graph's resources (queries, host readback), so it is never culled
+			void hasSideEffects();
+
+		private:
+			friend class VTAFrameGraph;
+			PassBuilder(VTAFrameGraph& graph, uint32_t pass) : graph{ graph }, pass{ pass } {}
+
+			VTAFrameGraph& graph;
+			uint32_t pass;
+		};
+
+		using Setup = std::function<void(PassBuilder& builder)>;
+		using Execute = std::function<void(VkCommandBuffer commandBuffer)>;
+
+		explicit VTAFrameGraph(VTADevice& device) : device{ device } {}
+
+		VTAFrameGraph(const VTAFrameGraph&) = delete;
+		VTAFrameGraph& operator=(const VTAFrameGraph&) = delete;
+
+		// once per frame, after beginFrame waited on the frame's fence. Forgets last frame's passes and resources
+		void reset();
+
+		// an image that lives outside the graph. Writing to it keeps the writer alive. layout is what it is in when the
+		// graph starts and finalLayout what it is left in. An externally synchronized image is only used for ordering
+		// and culling, its passes do their own transitions, like the swap chain's render pass does
+		Resource importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+			VkImageLayout layout, VkImageLayout finalLayout);
+		Resource importExternallySynchronized(const std::string& name);
+		// a buffer that lives outside the graph, same as an image. Nothing is known about what used it before
+		// the graph, its first use waits for everything
+		Resource importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+		// setup runs straight away, execute when the graph is executed and only if the pass survives compile()
+		void addPass(const std::string& name, const Setup& setup, Execute execute);
+
+		void compile();
+		void execute(VkCommandBuffer commandBuffer);
+
+		// inside a pass's execute
+		VkImage getImage(Resource resource) const;
+		VkImageView getImageView(Resource resource) const;
+		VkBuffer getBuffer(Resource resource) const;
+
+		struct Stats
+		{
+			uint32_t passesCulled = 0;
+			uint32_t barriers = 0; // image and buffer barriers recorded by the last execute
+
+			bool operator==(const Stats& other) const = default;
+		};
+		const Stats& getStats() const { return stats; }
+
+	private:
+		struct Usage
+		{
+			Resource resource;
+			FrameGraphUsage usage;
+			bool write;
+			bool discard;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			Execute execute;
+			std::vector<Usage> usages;
+			bool sideEffects = false;
+			bool culled = false;
+		};
+
+		struct ResourceNode
+		{
+			std::string name;
+			bool externallySynchronized = false;
+			bool isBuffer = false;
+			bool used = false; // by a pass that survived culling
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageAspectFlags aspect = 0;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize bufferOffset = 0;
+			VkDeviceSize bufferSize = VK_WHOLE_SIZE;
+		};
+
+		// what a resource was last used for, the barrier in front of its next use starts from here
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // stays undefined for buffers
+			VkPipelineStageFlags2KHR writeStages = 0;
+			VkAccessFlags2KHR writeAccess = 0;
+			VkPipelineStageFlags2KHR readStages = 0;  // readers since the last write
+			VkAccessFlags2KHR readAccess = 0;         // what those readers already see
+		};
+
+		void checkUsage(Resource resource, FrameGraphUsage usage, uint32_t pass) const;
+
+		void cullPasses();
+		void recordBarriers(VkCommandBuffer commandBuffer, uint32_t passIndex, std::vector<ResourceState>& states);
+		// one vkCmdPipelineBarrier2 for the batch, or vkCmdPipelineBarrier without VK_KHR_synchronization2
+		void submitBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2KHR>& barriers,
+			const std::vector<VkBufferMemoryBarrier2KHR>& bufferBarriers = {});
+
+		VTADevice& device;
+
+		std::vector<Pass> passes;
+		std::vector<ResourceNode> resources;
+		bool compiled = false;
+
+		Stats stats;
+	};
+}
@@ -6,7 +6,26 @@
 
 namespace VTA {
 
-#define MAX_LIGHTS 100
+	class VTAFrameDescriptorAllocator;
+	class VTADescriptorCache;
+	class VTAParallelRecorder;
+
+#define MAX_LIGHTS 100 // size of the ubo array, shaders are specialized down to the lights a scene actually has
+
+	// constant_id values declared by the shaders, set through PipelineConfigInfo::specialization
+	namespace SpecializationId
+	{
+		constexpr uint32_t MaxLights = 0;       // uint, upper bound of the point light loop
+		constexpr uint32_t TextureSampling = 1; // bool, without it objects take their vertex color
+		constexpr uint32_t LightingModel = 2;   // uint, one of LightingModel
+	}
+
+	enum class LightingModel : uint32_t
+	{
+		BlinnPhong = 0,
+		Lambert = 1, // diffuse only
+		Unlit = 2,
+	};
 
 	struct PointLight
 	{
@@ -34,5 +53,8 @@ namespace VTA {
 		VTACamera& camera;
 		std::vector<VkDescriptorSet> descriptorSets;
 		VTAGameObject::Map& gameObjects;
+		VTAFrameDescriptorAllocator* frameDescriptors = nullptr; // reset every time this frame index comes around
+		VTAParallelRecorder* parallelRecorder = nullptr; // set when the pass takes secondaries, every draw goes through it
+		VTADescriptorCache* descriptorCache = nullptr; // sets that outlive the frame, invalidated when their resources go
 	};
 }
\ No newline at end of file
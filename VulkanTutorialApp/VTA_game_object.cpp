@@ -2,7 +2,7 @@
 
 namespace VTA
 {
-	glm::mat4 TransformComponent::mat4() {
+	glm::mat4 TransformComponent::mat4() const {
 
 		auto transform = glm::translate(glm::mat4(1.f), translation);
 
@@ -14,7 +14,7 @@ namespace VTA
 		return transform;
 	}
 
-	glm::mat3 TransformComponent::normalMatrix() {
+	glm::mat3 TransformComponent::normalMatrix() const {
 		return glm::transpose(glm::inverse(glm::mat3(mat4())));
 	}
 	VTAGameObject VTAGameObject::makePointLight(float intensity, float radius, glm::vec3 color)
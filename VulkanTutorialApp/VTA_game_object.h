@@ -19,8 +19,8 @@ namespace VTA
 		glm::vec3 rotation{};
 
 		// Matrix corresponds to translate * Ry *Rx * Rz * scale transformation
-		glm::mat4 mat4();
-		glm::mat3 normalMatrix();
+		glm::mat4 mat4() const;
+		glm::mat3 normalMatrix() const;
 	};
 
 
@@ -1,7 +1,14 @@
 #include "VTA_image.h"
 #include <stdexcept>
 #include "VTA_buffer.h"
+#include "VTA_mip_downsampler.h"
+#include "VTA_mipgen.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cmath>
+#include <iostream>
+#include <vector>
 
 namespace VTA_Image
 {
@@ -66,10 +73,9 @@ namespace VTA_Image
 		return imageView;
 	}
 
-	void transitionImageLayout(VTA::VTADevice& device, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+	// records a layout transition of every mip level, the caller owns submission
+	void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 	{
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldLayout;
@@ -116,53 +122,126 @@ namespace VTA_Image
 			0, nullptr,
 			1, &barrier
 		);
+	}
 
 
-		device.endSingleTimeCommands(commandBuffer);
 
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMipLevel, uint32_t levelCount,
+		VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t layerCount)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseMipLevel;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layerCount;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
 
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
 	}
 
+	// usage narrows what the view inherits from the image, a storage image's SRGB views must not claim storage
+	VkImageView createMipImageView(VTA::VTADevice& device, VkImage image, VkFormat format, uint32_t mipLevel, VkImageUsageFlags usage)
+	{
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = usage;
 
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.pNext = &usageInfo;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = mipLevel;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
 
-	void copyBufferToImage(VTA::VTADevice& device, VTA::VTABuffer& buffer, VkImage image, uint32_t width, uint32_t height)
-	{
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-		// specify which part of the buffer is going to be copired to which part of the image
-		VkBufferImageCopy region{};
-
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0; // setting 0 here means that they are tightly packed
-		region.bufferImageHeight = 0;
-
-		// to which part of the image to copy the pixels
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = {
-			width,
-			height,
-			1
-		};
+		VkImageView imageView;
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image view!");
+		}
+		return imageView;
+	}
 
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VTA::VTABuffer& buffer, VkImage image, const std::vector<VkBufferImageCopy>& regions)
+	{
 		vkCmdCopyBufferToImage(
 			commandBuffer,
 			buffer.getBuffer(),
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
+			static_cast<uint32_t>(regions.size()),
+			regions.data()
 		);
+	}
 
-		device.endSingleTimeCommands(commandBuffer);
+	// blitting with a linear filter needs all three of these on the optimal tiling of the format
+	bool supportsLinearBlit(VTA::VTADevice& device, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format, &formatProperties);
+
+		VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & required) == required;
 	}
 
+	// smallest format that holds the source channels. three channel formats are rarely sampleable, so RGB gets padded to RGBA,
+	// and sRGB two channel formats would gamma decode the alpha. a reduced format also has to be blittable,
+	// the compute and CPU mip generators only handle four channels
+	VkFormat chooseTextureFormat(VTA::VTADevice& device, int sourceChannels, TextureUsage usage, uint32_t& channelCount)
+	{
+		bool srgb = usage == TextureUsage::Color;
+		VkFormat reduced = VK_FORMAT_UNDEFINED;
+		if (sourceChannels == 1)
+		{
+			reduced = srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+		}
+		else if (sourceChannels == 2 && !srgb)
+		{
+			reduced = VK_FORMAT_R8G8_UNORM;
+		}
+
+		if (reduced != VK_FORMAT_UNDEFINED && supportsLinearBlit(device, reduced))
+		{
+			channelCount = static_cast<uint32_t>(sourceChannels);
+			return reduced;
+		}
+
+		channelCount = 4;
+		return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
 
-	Texture::Texture(VTA::VTADevice& device, const char* filepath):
-		filepath(filepath), device(device)
+	// shaders keep sampling rgba: grey is repeated across rgb and a second channel becomes alpha
+	VkComponentMapping channelSwizzle(uint32_t channelCount)
+	{
+		switch (channelCount)
+		{
+		case 1:
+			return { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+		case 2:
+			return { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+		default:
+			return { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+		}
+	}
+
+	Texture::Texture(VTA::VTADevice& device, const char* filepath, TextureUsage usage, VTA::VTAMipDownsampler* downsampler, VTA::VTAThreadPool* threadPool):
+		filepath(filepath), usage(usage), device(device), downsampler(downsampler), threadPool(threadPool)
 	{
 		createTextureImage();
 		writeToDevice();
@@ -179,8 +258,15 @@ namespace VTA_Image
 	}
 	void Texture::createTextureImage()
 	{
-		pixels = stbi_load(filepath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		imageSize = texWidth * texHeight * 4; // 4 because r, g, b, a
+		// only the header is read here, the channel count decides the format before anything is decoded
+		if (!stbi_info(filepath, &texWidth, &texHeight, &texChannels))
+		{
+			throw std::runtime_error("failed to loaad texture image");
+		}
+		format = chooseTextureFormat(device, texChannels, usage, channelCount);
+
+		pixels = stbi_load(filepath, &texWidth, &texHeight, &texChannels, static_cast<int>(channelCount)); // stbi converts to channelCount
+		imageSize = texWidth * texHeight * channelCount;
 
 		if (!pixels)
 		{
@@ -193,20 +279,65 @@ namespace VTA_Image
 	}
 	void Texture::writeToDevice()
 	{
+		auto uploadStart = std::chrono::high_resolution_clock::now();
+
+		// compute writes the chain through UNORM storage views of the RGBA image. without that or linear blit support
+		// the whole mip chain is built on the CPU and uploaded with the base level. Textures the downsampler can't
+		// reduce in one dispatch (above 4096 with more than 6 levels) take the blit path
+		bool computeMipmaps = downsampler != nullptr && channelCount == 4 && mipLevels > 1 &&
+			VTA::VTAMipDownsampler::supportsTarget(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), mipLevels - 1) &&
+			VTA::VTAMipDownsampler::supportsFormat(device, VK_FORMAT_R8G8B8A8_UNORM);
+		bool gpuMipmaps = computeMipmaps || supportsLinearBlit(device, format);
+		assert((gpuMipmaps || channelCount == 4) && "Reduced channel formats are only picked when they can be blitted");
+
+		std::vector<VkBufferImageCopy> regions;
+		VkDeviceSize stagingSize = 0;
+		int32_t mipWidth = texWidth;
+		int32_t mipHeight = texHeight;
+		uint32_t stagedLevels = gpuMipmaps ? 1 : mipLevels;
+		for (uint32_t i = 0; i < stagedLevels; i++)
+		{
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingSize;
+			region.bufferRowLength = 0; // setting 0 here means that they are tightly packed
+			region.bufferImageHeight = 0;
+			// to which part of the image to copy the pixels
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { static_cast<uint32_t>(mipWidth), static_cast<uint32_t>(mipHeight), 1 };
+			regions.push_back(region);
+
+			stagingSize += static_cast<VkDeviceSize>(mipWidth) * mipHeight * channelCount;
+			if (mipWidth > 1) mipWidth /= 2;
+			if (mipHeight > 1) mipHeight /= 2;
+		}
+
 		// write to staging buffer
 		uint32_t channelSize = sizeof(stbi_uc);
-		VTA::VTABuffer stagingBuffer{ device, channelSize, imageSize,
+		VTA::VTABuffer stagingBuffer{ device, channelSize, static_cast<uint32_t>(stagingSize),
 										VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 										VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT }; 
 		stagingBuffer.map();
-		stagingBuffer.writeToBuffer(pixels);
+		stagingBuffer.writeToBuffer(pixels, imageSize, 0);
+
+		// each level is downsampled straight into mapped memory from the previous one
+		if (stagedLevels > 1)
+		{
+			auto* staged = static_cast<stbi_uc*>(stagingBuffer.getMappedMemory());
+			std::vector<MipLevel> levels;
+			for (const auto& region : regions)
+			{
+				levels.push_back({ staged + region.bufferOffset, region.imageExtent.width, region.imageExtent.height });
+			}
+			MipGenerator{ threadPool }.generate(levels, MipFilter::Box, usage == TextureUsage::Color);
+		}
 		stbi_image_free(pixels); // clean up original pixel array
 
 		// write to the image on the device
-		VkImageCreateInfo imageInfo = constructImageCreateInfo();
-
-		
-		VkDeviceMemory textureImageMemory;
+		VkImageCreateInfo imageInfo = constructImageCreateInfo(computeMipmaps);
 
 		if (vkCreateImage(device.device(), &imageInfo, nullptr, &textureImage) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
@@ -223,26 +354,50 @@ namespace VTA_Image
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &textureImageMemory) != VK_SUCCESS) {
+		if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate image memory!");
 		}
 
-		vkBindImageMemory(device.device(), textureImage, textureImageMemory, 0);
-		transitionImageLayout(device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-		copyBufferToImage(device, stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		generateMipmaps();
-		//transitionImageLayout(device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+		vkBindImageMemory(device.device(), textureImage, imageMemory, 0);
+
+		// transitions, copy and the whole mip chain go into one command buffer with a single wait at the end
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		transitionImageLayout(commandBuffer, textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		copyBufferToImage(commandBuffer, stagingBuffer, textureImage, regions);
+		std::vector<VkImageView> transientViews;
+		if (computeMipmaps)
+		{
+			generateMipmapsCompute(commandBuffer, transientViews);
+		}
+		else if (gpuMipmaps)
+		{
+			generateMipmaps(commandBuffer); // leaves every level in SHADER_READ_ONLY_OPTIMAL
+		}
+		else
+		{
+			transitionImageLayout(commandBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+		}
+		device.endSingleTimeCommands(commandBuffer);
+
+		// the submission has finished, the views and descriptor sets used by the dispatch can go
+		for (auto view : transientViews)
+		{
+			vkDestroyImageView(device.device(), view, nullptr);
+		}
+		if (computeMipmaps)
+		{
+			downsampler->resetDescriptors();
+		}
 
+		if (LOG_UPLOAD_TIMES)
+		{
+			auto uploadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+			std::cout << "Texture " << filepath << " uploaded in " << uploadTime << " ms (" << (computeMipmaps ? "compute" : gpuMipmaps ? "blit" : "CPU") << " mipmaps)\n";
+		}
 	}
 
-	void Texture::generateMipmaps()
+	void Texture::generateMipmaps(VkCommandBuffer commandBuffer)
 	{
-		std::vector<VkFormat> formats { VK_FORMAT_R8G8B8A8_SRGB };
-		// if the line below doesn't throw an error, then the device supports blitting
-		device.findSupportedFormat(formats, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
-		
-
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
 		VkImageMemoryBarrier barrier{};
 		// these fields will be the same for each level
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -322,14 +477,67 @@ namespace VTA_Image
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
+	}
 
+	void Texture::generateMipmapsCompute(VkCommandBuffer commandBuffer, std::vector<VkImageView>& transientViews)
+	{
+		uint32_t generatedLevels = mipLevels - 1;
 
-		device.endSingleTimeCommands(commandBuffer);
+		VTA::VTAMipDownsampler::Target target{};
+		target.sourceView = createMipImageView(device, textureImage, format, 0, VK_IMAGE_USAGE_SAMPLED_BIT); // sampling linearises an SRGB level 0
+		transientViews.push_back(target.sourceView);
+		for (uint32_t i = 0; i < generatedLevels; i++)
+		{
+			target.mipViews[i] = createMipImageView(device, textureImage, VK_FORMAT_R8G8B8A8_UNORM, i + 1, VK_IMAGE_USAGE_STORAGE_BIT);
+			transientViews.push_back(target.mipViews[i]);
+		}
+		target.width = static_cast<uint32_t>(texWidth);
+		target.height = static_cast<uint32_t>(texHeight);
+		target.mipCount = generatedLevels;
+		target.srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+		target.filter = VTA::VTAMipDownsampler::Filter::Box;
+
+		// level 0 was just copied in, the rest of the chain becomes storage for the dispatch
+		imageBarrier(commandBuffer, textureImage, 0, 1,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		imageBarrier(commandBuffer, textureImage, 1, generatedLevels,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		downsampler->downsample(commandBuffer, target);
+
+		imageBarrier(commandBuffer, textureImage, 1, generatedLevels,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 	}
 
 	void Texture::createTextureImageView()
 	{
-		imageView = createImageView(device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, mipLevels);
+		// only sampled, with compute mips the image also has storage usage that its SRGB format can't have
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.pNext = &usageInfo;
+		viewInfo.image = textureImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.components = channelSwizzle(channelCount);
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture image view!");
+		}
 	}
 
 	void Texture::createTextureSampler()
@@ -381,7 +589,7 @@ namespace VTA_Image
 	}
 
 
-	VkImageCreateInfo Texture::constructImageCreateInfo()
+	VkImageCreateInfo Texture::constructImageCreateInfo(bool storageMips)
 	{
 		VkImageCreateInfo imageInfo{};
 
@@ -392,7 +600,7 @@ namespace VTA_Image
 		imageInfo.extent.depth = 1;
 		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
-		imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		imageInfo.format = format;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL; // because we are using a staging buffer instead of a staging image
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // we only want to set thsi to preinitialized if we intend to use s staging imaghe
 		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // transfer destination and a place to be sampled from
@@ -400,6 +608,13 @@ namespace VTA_Image
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT; // this is only relevant for images that will be used for multi-sampling as an attachment
 		imageInfo.flags = 0; // Optional
 
+		if (storageMips)
+		{
+			// SRGB has no storage support, the compute downsampler writes through UNORM views of the same memory
+			imageInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			imageInfo.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+		}
+
 		return imageInfo;
 	}
 
@@ -3,6 +3,14 @@
 #include <stb_image.h>
 #include "VTA_device.hpp"
 
+#include <vector>
+
+namespace VTA
+{
+	class VTAMipDownsampler;
+	class VTAThreadPool;
+	class VTABuffer;
+}
 
 
 namespace VTA_Image
@@ -12,26 +20,53 @@ namespace VTA_Image
 		VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VTA::VTADevice& device);
 
 	VkImageView createImageView(VTA::VTADevice& device, VkImage image, VkFormat format, uint32_t mipLevel);
+
+	// recording helpers, the caller owns the command buffer and its submission
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMipLevel, uint32_t levelCount,
+		VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t layerCount = 1);
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VTA::VTABuffer& buffer, VkImage image, const std::vector<VkBufferImageCopy>& regions);
 	// what does a texture need to be created
 
+	// decides between sRGB and UNORM formats
+	enum class TextureUsage
+	{
+		Color, // albedo and the like, stored as sRGB
+		Data,  // roughness, AO, masks, normals: stored as UNORM and read back unchanged
+	};
+
 	class Texture
 	{
 	public:
-		Texture(VTA::VTADevice& device, const char* filepath);
+		static constexpr bool LOG_UPLOAD_TIMES = false; // prints each texture's upload time and which mip path it took
+
+		// the format is the smallest of R8 / RG8 / RGBA8 that holds the file's channels, the view swizzles it back to RGBA.
+		// with a downsampler the mip chain is built by one compute dispatch instead of a chain of blits.
+		// the thread pool only gets used when the mips have to be built on the CPU
+		Texture(VTA::VTADevice& device, const char* filepath, TextureUsage usage = TextureUsage::Color,
+			VTA::VTAMipDownsampler* downsampler = nullptr, VTA::VTAThreadPool* threadPool = nullptr);
 		~Texture();
 
 		VkDescriptorImageInfo descriptorInfo();
+		const char* getFilepath() const { return filepath; }
+		VkFormat getFormat() const { return format; }
 	private:
 
 		int texWidth;
 		int texHeight;
-		int texChannels;
+		int texChannels; // in the file
+		uint32_t channelCount; // in the image, texChannels rounded to 1, 2 or 4
 		uint32_t imageSize;
 		stbi_uc* pixels;
 		const char* filepath;
 		uint32_t mipLevels;
+		TextureUsage usage;
+		VkFormat format;
 
 		VTA::VTADevice& device;
+		VTA::VTAMipDownsampler* downsampler;
+		VTA::VTAThreadPool* threadPool;
 
 		//Resources
 		
@@ -53,9 +88,10 @@ namespace VTA_Image
 		void writeToDevice();
 		void createTextureImageView();
 		void createTextureSampler();
-		void generateMipmaps();
+		void generateMipmaps(VkCommandBuffer commandBuffer);
+		void generateMipmapsCompute(VkCommandBuffer commandBuffer, std::vector<VkImageView>& transientViews);
 		
-		VkImageCreateInfo constructImageCreateInfo();
+		VkImageCreateInfo constructImageCreateInfo(bool storageMips);
 
 	};
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "VTA_layout_cache.h"
+#include "VTA_utils.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+
+namespace VTA {
+
+    namespace {
+
+        // non-dispatchable handles are pointers on 64 bit and integers on 32 bit platforms
+        template <typename T>
+        uint64_t handleKey(T handle) {
+            return (uint64_t)handle;
+        }
+
+    }
+
+    // *************** Keys *********************
+
+    bool VTALayoutCache::SetLayoutKey::operator==(const SetLayoutKey& other) const {
+        if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags) {
+            return false;
+        }
+        for (size_t i = 0; i < bindings.size(); i++) {
+            const auto& a = bindings[i];
+            const auto& b = other.bindings[i];
+            if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+                a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags ||
+                a.pImmutableSamplers != b.pImmutableSamplers) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t VTALayoutCache::SetLayoutKeyHash::operator()(const SetLayoutKey& key) const {
+        size_t seed = 0;
+        hashCombine(seed, key.flags);
+        for (size_t i = 0; i < key.bindings.size(); i++) {
+            const auto& b = key.bindings[i];
+            hashCombine(seed, b.binding, static_cast<uint32_t>(b.descriptorType), b.descriptorCount, b.stageFlags, key.bindingFlags[i]);
+        }
+        return seed;
+    }
+
+    bool VTALayoutCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const {
+        if (setLayouts != other.setLayouts || pushConstantRanges.size() != other.pushConstantRanges.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < pushConstantRanges.size(); i++) {
+            const auto& a = pushConstantRanges[i];
+            const auto& b = other.pushConstantRanges[i];
+            if (a.stageFlags != b.stageFlags || a.offset != b.offset || a.size != b.size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t VTALayoutCache::PipelineLayoutKeyHash::operator()(const PipelineLayoutKey& key) const {
+        size_t seed = 0;
+        for (auto setLayout : key.setLayouts) {
+            hashCombine(seed, handleKey(setLayout));
+        }
+        for (const auto& range : key.pushConstantRanges) {
+            hashCombine(seed, range.stageFlags, range.offset, range.size);
+        }
+        return seed;
+    }
+
+    // *************** Layout Cache *********************
+
+    VTALayoutCache::~VTALayoutCache() {
+        // anything left here was never released, the device is going away regardless
+        for (auto& kv : pipelineLayouts) {
+            vkDestroyPipelineLayout(device, kv.second.handle, nullptr);
+        }
+        for (auto& kv : setLayouts) {
+            vkDestroyDescriptorSetLayout(device, kv.second.handle, nullptr);
+        }
+    }
+
+    VkDescriptorSetLayout VTALayoutCache::acquireSetLayout(
+        VkDescriptorSetLayoutCreateFlags flags,
+        std::span<const VkDescriptorSetLayoutBinding> bindings,
+        std::span<const VkDescriptorBindingFlags> bindingFlags) {
+        assert((bindingFlags.empty() || bindingFlags.size() == bindings.size()) && "Binding flags have to be parallel to the bindings");
+
+        // the order bindings are listed in doesn't change the layout, sort them so it doesn't change the key either
+        std::vector<uint32_t> order(bindings.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bindings[a].binding < bindings[b].binding; });
+
+        SetLayoutKey key{};
+        key.flags = flags;
+        bool hasBindingFlags = false;
+        for (uint32_t i : order) {
+            key.bindings.push_back(bindings[i]);
+            key.bindingFlags.push_back(bindingFlags.empty() ? 0 : bindingFlags[i]);
+            hasBindingFlags |= key.bindingFlags.back() != 0;
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        auto found = setLayouts.find(key);
+        if (found != setLayouts.end()) {
+            found->second.refCount++;
+            stats.setLayoutHits++;
+            return found->second.handle;
+        }
+
+        // binding flags are parallel to pBindings and only needed for descriptor indexing features
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr;
+        layoutInfo.flags = flags;
+        layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+        layoutInfo.pBindings = key.bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        stats.setLayoutMisses++;
+        setLayoutKeys.emplace(layout, key);
+        setLayouts.emplace(std::move(key), Entry<VkDescriptorSetLayout>{ layout, 1 });
+        return layout;
+    }
+
+    void VTALayoutCache::releaseSetLayout(VkDescriptorSetLayout layout) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        dropSetLayoutReference(layout);
+    }
+
+    void VTALayoutCache::dropSetLayoutReference(VkDescriptorSetLayout layout) {
+        auto keyIt = setLayoutKeys.find(layout);
+        assert(keyIt != setLayoutKeys.end() && "Set layout was not acquired from this cache");
+
+        auto entryIt = setLayouts.find(keyIt->second);
+        if (--entryIt->second.refCount == 0) {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+            setLayouts.erase(entryIt);
+            setLayoutKeys.erase(keyIt);
+        }
+    }
+
+    VkPipelineLayout VTALayoutCache::acquirePipelineLayout(
+        std::span<const VkDescriptorSetLayout> setLayoutHandles,
+        std::span<const VkPushConstantRange> pushConstantRanges) {
+        PipelineLayoutKey key{};
+        key.setLayouts.assign(setLayoutHandles.begin(), setLayoutHandles.end());
+        key.pushConstantRanges.assign(pushConstantRanges.begin(), pushConstantRanges.end());
+
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        auto found = pipelineLayouts.find(key);
+        if (found != pipelineLayouts.end()) {
+            found->second.refCount++;
+            stats.pipelineLayoutHits++;
+            return found->second.handle;
+        }
+
+        for (auto setLayout : key.setLayouts) {
+            if (setLayoutKeys.find(setLayout) == setLayoutKeys.end()) {
+                throw std::runtime_error("failed to create pipeline layout, a set layout was not acquired from the layout cache!");
+            }
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = key.setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(key.pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = key.pushConstantRanges.data();
+
+        VkPipelineLayout layout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        // kept alive until the pipeline layout goes, see releasePipelineLayout
+        for (auto setLayout : key.setLayouts) {
+            setLayouts.find(setLayoutKeys.find(setLayout)->second)->second.refCount++;
+        }
+
+        stats.pipelineLayoutMisses++;
+        pipelineLayoutKeys.emplace(layout, key);
+        pipelineLayouts.emplace(std::move(key), Entry<VkPipelineLayout>{ layout, 1 });
+        return layout;
+    }
+
+    void VTALayoutCache::releasePipelineLayout(VkPipelineLayout layout) {
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        auto keyIt = pipelineLayoutKeys.find(layout);
+        assert(keyIt != pipelineLayoutKeys.end() && "Pipeline layout was not acquired from this cache");
+
+        auto entryIt = pipelineLayouts.find(keyIt->second);
+        if (--entryIt->second.refCount == 0) {
+            vkDestroyPipelineLayout(device, layout, nullptr);
+            for (auto setLayout : keyIt->second.setLayouts) {
+                dropSetLayoutReference(setLayout);
+            }
+            pipelineLayouts.erase(entryIt);
+            pipelineLayoutKeys.erase(keyIt);
+        }
+    }
+
+    VTALayoutCache::Stats VTALayoutCache::getStats() const {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return stats;
+    }
+
+}
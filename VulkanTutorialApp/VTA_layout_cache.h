@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace VTA {
+
+    // Device wide deduplication of descriptor set layouts and pipeline layouts. Identical binding lists, or
+    // identical set layouts and push constant ranges, come back as the same reference counted handle, so render
+    // systems with the same interface share a pipeline layout and compatible sets stay bound across pipeline switches.
+    class VTALayoutCache {
+    public:
+        struct Stats {
+            uint32_t setLayoutHits = 0;
+            uint32_t setLayoutMisses = 0;
+            uint32_t pipelineLayoutHits = 0;
+            uint32_t pipelineLayoutMisses = 0;
+        };
+
+        explicit VTALayoutCache(VkDevice device) : device{ device } {}
+        ~VTALayoutCache();
+
+        VTALayoutCache(const VTALayoutCache&) = delete;
+        VTALayoutCache& operator=(const VTALayoutCache&) = delete;
+
+        // every acquire is paired with a release of the handle it returned. bindingFlags is empty or parallel to bindings
+        VkDescriptorSetLayout acquireSetLayout(
+            VkDescriptorSetLayoutCreateFlags flags,
+            std::span<const VkDescriptorSetLayoutBinding> bindings,
+            std::span<const VkDescriptorBindingFlags> bindingFlags = {});
+        void releaseSetLayout(VkDescriptorSetLayout layout);
+
+        // setLayouts have to come from this cache. A cached pipeline layout holds a reference on each of them, so their
+        // handles can't be destroyed and reused by a different layout while the key still names them
+        VkPipelineLayout acquirePipelineLayout(
+            std::span<const VkDescriptorSetLayout> setLayouts,
+            std::span<const VkPushConstantRange> pushConstantRanges = {});
+        void releasePipelineLayout(VkPipelineLayout layout);
+
+        Stats getStats() const;
+
+    private:
+        struct SetLayoutKey {
+            VkDescriptorSetLayoutCreateFlags flags;
+            std::vector<VkDescriptorSetLayoutBinding> bindings; // sorted by binding
+            std::vector<VkDescriptorBindingFlags> bindingFlags; // parallel to bindings, all zero without flags
+
+            bool operator==(const SetLayoutKey& other) const;
+        };
+
+        struct SetLayoutKeyHash {
+            size_t operator()(const SetLayoutKey& key) const;
+        };
+
+        struct PipelineLayoutKey {
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            std::vector<VkPushConstantRange> pushConstantRanges;
+
+            bool operator==(const PipelineLayoutKey& other) const;
+        };
+
+        struct PipelineLayoutKeyHash {
+            size_t operator()(const PipelineLayoutKey& key) const;
+        };
+
+        // the part of releaseSetLayout that runs with the mutex held
+        void dropSetLayoutReference(VkDescriptorSetLayout layout);
+
+        template <typename Handle>
+        struct Entry {
+            Handle handle;
+            uint32_t refCount;
+        };
+
+        VkDevice device;
+        mutable std::mutex mutex;
+
+        std::unordered_map<SetLayoutKey, Entry<VkDescriptorSetLayout>, SetLayoutKeyHash> setLayouts;
+        std::unordered_map<VkDescriptorSetLayout, SetLayoutKey> setLayoutKeys; // to find the entry on release
+        std::unordered_map<PipelineLayoutKey, Entry<VkPipelineLayout>, PipelineLayoutKeyHash> pipelineLayouts;
+        std::unordered_map<VkPipelineLayout, PipelineLayoutKey> pipelineLayoutKeys;
+
+        Stats stats{};
+    };
+
+}
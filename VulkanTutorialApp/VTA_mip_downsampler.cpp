@@ -0,0 +1,221 @@
+#include "VTA_mip_downsampler.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace VTA
+{
+	VTAMipDownsampler::VTAMipDownsampler(VTADevice& device, Format format, VTADescriptorBackend backend) : device{ device }
+	{
+		bool useDescriptorBuffer = VTADescriptorBuffer::resolve(device, backend) == VTADescriptorBackend::DescriptorBuffer;
+
+		auto layoutBuilder = VTADescriptorSetLayout::Builder(device);
+		layoutBuilder
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, MAX_MIPS)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+		if (useDescriptorBuffer)
+		{
+			layoutBuilder.useDescriptorBuffer();
+		}
+		setLayout = layoutBuilder.build();
+
+		VkBufferUsageFlags counterUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		if (useDescriptorBuffer)
+		{
+			VkDeviceSize alignment = device.descriptorBufferProperties.descriptorBufferOffsetAlignment;
+			VkDeviceSize setSize = (setLayout->getDescriptorBufferSize() + alignment - 1) & ~(alignment - 1);
+			descriptorBuffer = std::make_unique<VTADescriptorBuffer>(device, setSize * DESCRIPTOR_BUFFER_SETS);
+			counterUsage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT; // descriptors of buffers are built from their address
+		}
+		else
+		{
+			std::vector<VTADescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
+				{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_MIPS + 1 },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+			};
+			descriptorAllocator.init(device.device(), 16, sizes);
+		}
+
+		counterBuffer = std::make_unique<VTABuffer>(device, sizeof(uint32_t), 1,
+			counterUsage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		createSampler();
+		createPipelineLayout();
+		createPipeline(format);
+	}
+
+	VTAMipDownsampler::~VTAMipDownsampler()
+	{
+		if (!descriptorBuffer)
+		{
+			descriptorAllocator.destroy_pools(device.device());
+		}
+		device.layoutCache().releasePipelineLayout(pipelineLayout);
+		vkDestroySampler(device.device(), sampler, nullptr);
+	}
+
+	bool VTAMipDownsampler::supportsFormat(VTADevice& device, VkFormat storageFormat)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device.physicalDevice, storageFormat, &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+	}
+
+	void VTAMipDownsampler::createSampler()
+	{
+		// the shader uses texelFetch, the sampler is only there to complete the combined image sampler
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.maxLod = 0.0f;
+
+		if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler sampler!");
+		}
+	}
+
+	void VTAMipDownsampler::createPipelineLayout()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		pipelineLayout = device.layoutCache().acquirePipelineLayout({ &descriptorSetLayout, 1 }, { &pushConstantRange, 1 });
+	}
+
+	void VTAMipDownsampler::createPipeline(Format format)
+	{
+		// constant_id 0 switches the quad reduction from shared memory to subgroup swaps
+		VkBool32 useSubgroupQuad = device.subgroupQuadComputeSupported ? VK_TRUE : VK_FALSE;
+
+		VkSpecializationMapEntry mapEntry{};
+		mapEntry.constantID = 0;
+		mapEntry.offset = 0;
+		mapEntry.size = sizeof(VkBool32);
+
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &mapEntry;
+		specializationInfo.dataSize = sizeof(VkBool32);
+		specializationInfo.pData = &useSubgroupQuad;
+
+		const char* shader = format == Format::R32F ? "spd_downsample_r32f.comp.spv" : "spd_downsample.comp.spv";
+		VkPipelineCreateFlags flags = descriptorBuffer ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+		pipeline = std::make_unique<VTAComputePipeline>(device, shader, pipelineLayout, &specializationInfo, flags);
+	}
+
+	void VTAMipDownsampler::downsample(VkCommandBuffer commandBuffer, const Target& target)
+	{
+		assert(supportsTarget(target.width, target.height, target.mipCount) &&
+			"Between 1 and 12 levels, and level 6 has to fit in one 64x64 tile when there are more than 6");
+
+		// every slot of the array needs a valid view, the shader never writes past mipCount
+		VkDescriptorImageInfo sourceInfo{ sampler, target.sourceView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		std::array<VkDescriptorImageInfo, MAX_MIPS> mipInfos{};
+		for (uint32_t i = 0; i < MAX_MIPS; i++)
+		{
+			mipInfos[i] = { VK_NULL_HANDLE, target.mipViews[std::min(i, target.mipCount - 1)], VK_IMAGE_LAYOUT_GENERAL };
+		}
+		VkDescriptorImageInfo mip6Info = mipInfos[5];
+		VkDescriptorBufferInfo counterInfo = counterBuffer->descriptorInfo(counterBuffer->getBufferSize()); // descriptor buffers need a real range
+
+		VTADescriptorWriter writer{ *setLayout };
+		writer.writeImage(0, &sourceInfo);
+		for (uint32_t i = 0; i < MAX_MIPS; i++)
+		{
+			writer.writeImageArrayElement(1, i, &mipInfos[i]);
+		}
+		writer.writeImage(2, &mip6Info);
+		writer.writeBuffer(3, &counterInfo);
+
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkDeviceSize descriptorOffset = 0;
+		if (descriptorBuffer)
+		{
+			descriptorOffset = descriptorBuffer->allocate(*setLayout);
+			writer.overwrite(*descriptorBuffer, descriptorOffset);
+		}
+		else
+		{
+			descriptorSet = descriptorAllocator.allocate(device.device(), setLayout->getDescriptorSetLayout());
+			writer.overwrite(descriptorSet, device);
+		}
+
+		// the counter is shared by every dispatch, wait for the previous one before zeroing it
+		VkBufferMemoryBarrier counterBarrier{};
+		counterBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		counterBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		counterBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		counterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		counterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		counterBarrier.buffer = counterBuffer->getBuffer();
+		counterBarrier.offset = 0;
+		counterBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			1, &counterBarrier,
+			0, nullptr);
+
+		vkCmdFillBuffer(commandBuffer, counterBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+		counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr,
+			1, &counterBarrier,
+			0, nullptr);
+
+		// one workgroup per 64x64 tile of level 0
+		uint32_t groupsX = (target.width + 63) / 64;
+		uint32_t groupsY = (target.height + 63) / 64;
+
+		PushConstants push{};
+		push.sourceSize[0] = static_cast<int32_t>(target.width);
+		push.sourceSize[1] = static_cast<int32_t>(target.height);
+		push.mipCount = target.mipCount;
+		push.numWorkGroups = groupsX * groupsY;
+		push.filterMode = static_cast<uint32_t>(target.filter);
+		push.srgb = target.srgb ? 1 : 0;
+
+		pipeline->bind(commandBuffer);
+		if (descriptorBuffer)
+		{
+			descriptorBuffer->bindBuffer(commandBuffer);
+			descriptorBuffer->bindSet(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, descriptorOffset);
+		}
+		else
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		}
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+		vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+	}
+
+	void VTAMipDownsampler::resetDescriptors()
+	{
+		if (descriptorBuffer)
+		{
+			descriptorBuffer->reset();
+			return;
+		}
+		descriptorAllocator.clear_pools(device.device());
+	}
+}
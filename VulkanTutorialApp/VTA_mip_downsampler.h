@@ -0,0 +1,95 @@
+#pragma once
+
+#include "VTA_device.hpp"
+#include "VTA_descriptors.h"
+#include "VTA_descriptor_buffer.h"
+#include "VTA_pipeline.h"
+#include "VTA_buffer.h"
+
+#include <array>
+#include <memory>
+
+namespace VTA
+{
+	// Compute based single pass mip generation (spd_downsample.comp). Up to 12 levels below level 0
+	// come out of one dispatch, and unlike vkCmdBlitImage it can run custom filters.
+	// The same kernel builds depth pyramids with Format::R32F and the Min/Max filters.
+	class VTAMipDownsampler
+	{
+	public:
+		static constexpr uint32_t MAX_MIPS = 12;
+
+		enum class Format { RGBA8, R32F };
+
+		// matches the FILTER_* values in the shader
+		enum class Filter : uint32_t
+		{
+			Box = 0,
+			Kaiser = 1,
+			AlphaWeighted = 2,
+			NormalMap = 3,
+			Min = 4,
+			Max = 5,
+		};
+
+		// layouts are the caller's job: level 0 in SHADER_READ_ONLY_OPTIMAL, levels 1..mipCount in GENERAL
+		struct Target
+		{
+			VkImageView sourceView;                    // sampled view of level 0
+			std::array<VkImageView, MAX_MIPS> mipViews; // single level storage views, mipViews[i] is level i + 1
+			uint32_t width;                            // of level 0
+			uint32_t height;
+			uint32_t mipCount;                         // levels to write, at most MAX_MIPS
+			bool srgb = false;                         // storage views are UNORM aliases of an SRGB image
+			Filter filter = Filter::Box;
+		};
+
+		VTAMipDownsampler(VTADevice& device, Format format = Format::RGBA8, VTADescriptorBackend backend = VTADescriptorBackend::Auto);
+		~VTAMipDownsampler();
+
+		VTAMipDownsampler(const VTAMipDownsampler&) = delete;
+		VTAMipDownsampler& operator=(const VTAMipDownsampler&) = delete;
+
+		// storage image support for the format the storage views will use
+		static bool supportsFormat(VTADevice& device, VkFormat storageFormat);
+		// levels past 6 are reduced by a single workgroup, so level 6 has to fit in one 64x64 tile
+		static bool supportsTarget(uint32_t width, uint32_t height, uint32_t mipCount)
+		{
+			return mipCount > 0 && mipCount <= MAX_MIPS && (mipCount <= 6 || (width <= 4096 && height <= 4096));
+		}
+
+		void downsample(VkCommandBuffer commandBuffer, const Target& target);
+
+		// descriptor sets of recorded dispatches stay alive until this is called, once the GPU is done with them
+		void resetDescriptors();
+
+		bool usesDescriptorBuffer() const { return descriptorBuffer != nullptr; }
+
+	private:
+		static constexpr uint32_t DESCRIPTOR_BUFFER_SETS = 64; // dispatches between two resetDescriptors
+
+		struct PushConstants
+		{
+			int32_t sourceSize[2];
+			uint32_t mipCount;
+			uint32_t numWorkGroups;
+			uint32_t filterMode;
+			uint32_t srgb;
+		};
+
+		void createSampler();
+		void createPipelineLayout();
+		void createPipeline(Format format);
+
+		VTADevice& device;
+
+		std::unique_ptr<VTADescriptorSetLayout> setLayout;
+		std::unique_ptr<VTADescriptorBuffer> descriptorBuffer; // sets go here when the backend is DescriptorBuffer
+		VTADescriptorAllocatorGrowable descriptorAllocator;    // and in pools otherwise
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<VTAComputePipeline> pipeline;
+
+		VkSampler sampler;
+		std::unique_ptr<VTABuffer> counterBuffer; // global atomic counter of finished workgroups
+	};
+}
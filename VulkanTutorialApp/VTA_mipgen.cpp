@@ -0,0 +1,551 @@
+#include "VTA_mipgen.h"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define VTA_MIPGEN_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define VTA_TARGET(isa) // msvc lets any function use any intrinsic
+#else
+#define VTA_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define VTA_MIPGEN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace VTA_Image
+{
+	namespace
+	{
+		// Kaiser taps (beta = 4) at 0.5 and 1.5 texels from the output centre, scaled so one axis sums to 256
+		constexpr uint32_t KAISER_NEAR = 114;
+		constexpr uint32_t KAISER_FAR = 14;
+
+		// rows of an output band are processed together, small levels end up as a single band
+		constexpr uint32_t MIN_TEXELS_PER_BAND = 16 * 1024;
+
+		// linear values are 16 bit per channel, RGBA interleaved like the source
+		struct ColorTables
+		{
+			uint16_t srgbToLinear[256];
+			uint8_t linearToSrgb[65536];
+			uint8_t linearToUnorm[65536];
+
+			ColorTables()
+			{
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					double c = i / 255.0;
+					double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+					srgbToLinear[i] = static_cast<uint16_t>(std::lround(linear * 65535.0));
+				}
+				for (uint32_t i = 0; i < 65536; i++)
+				{
+					double linear = i / 65535.0;
+					double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+					linearToSrgb[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.0, 1.0) * 255.0));
+					linearToUnorm[i] = static_cast<uint8_t>((i * 255 + 32767) / 65535);
+				}
+			}
+		};
+
+		const ColorTables& colorTables()
+		{
+			static const ColorTables tables;
+			return tables;
+		}
+
+		// scalar kernels, also used by the SIMD versions for edges and tails that need clamping
+
+		void boxRowScalar(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t x = begin; x < end; x++)
+			{
+				uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+					dst[x * 4 + c] = static_cast<uint16_t>((sum + 2) >> 2);
+				}
+			}
+		}
+
+		void kaiserColumnsScalar(const uint16_t* const rows[4], uint16_t* dst, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				uint32_t sum = (rows[0][i] + rows[3][i]) * KAISER_FAR + (rows[1][i] + rows[2][i]) * KAISER_NEAR;
+				dst[i] = static_cast<uint16_t>((sum + 128) >> 8);
+			}
+		}
+
+		void kaiserRowScalar(const uint16_t* src, uint32_t srcWidth, uint16_t* dst, uint32_t begin, uint32_t end)
+		{
+			int32_t last = static_cast<int32_t>(srcWidth) - 1;
+			for (uint32_t x = begin; x < end; x++)
+			{
+				int32_t base = static_cast<int32_t>(x) * 2 - 1;
+				uint32_t p0 = std::clamp(base, 0, last) * 4;
+				uint32_t p1 = std::clamp(base + 1, 0, last) * 4;
+				uint32_t p2 = std::clamp(base + 2, 0, last) * 4;
+				uint32_t p3 = std::clamp(base + 3, 0, last) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = (src[p0 + c] + src[p3 + c]) * KAISER_FAR + (src[p1 + c] + src[p2 + c]) * KAISER_NEAR;
+					dst[x * 4 + c] = static_cast<uint16_t>((sum + 128) >> 8);
+				}
+			}
+		}
+
+		// output texels in [0, end) whose box footprint needs no clamping
+		uint32_t boxInteriorEnd(uint32_t srcWidth, uint32_t dstWidth)
+		{
+			return std::min(dstWidth, srcWidth / 2);
+		}
+
+		// output texels in [1, end) whose 4 tap footprint (2x - 1 to 2x + 2) needs no clamping
+		uint32_t kaiserInteriorEnd(uint32_t srcWidth, uint32_t dstWidth)
+		{
+			return srcWidth >= 3 ? std::max(1u, std::min(dstWidth, (srcWidth - 3) / 2 + 1)) : 1;
+		}
+
+		void boxRowReference(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			boxRowScalar(row0, row1, srcWidth, dst, 0, dstWidth);
+		}
+
+		void kaiserColumnsReference(const uint16_t* const rows[4], uint16_t* dst, uint32_t count)
+		{
+			kaiserColumnsScalar(rows, dst, 0, count);
+		}
+
+		void kaiserRowReference(const uint16_t* src, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			kaiserRowScalar(src, srcWidth, dst, 0, dstWidth);
+		}
+
+#if defined(VTA_MIPGEN_X86)
+		VTA_TARGET("sse4.1")
+		inline __m128i kaiserTapsSse41(__m128i a, __m128i b, __m128i c, __m128i d)
+		{
+			__m128i sum = _mm_add_epi32(
+				_mm_mullo_epi32(_mm_add_epi32(a, d), _mm_set1_epi32(KAISER_FAR)),
+				_mm_mullo_epi32(_mm_add_epi32(b, c), _mm_set1_epi32(KAISER_NEAR)));
+			return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+		}
+
+		// two output texels per iteration from four source texels of each row
+		VTA_TARGET("sse4.1")
+		void boxRowSse41(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i round = _mm_set1_epi32(2);
+			uint32_t simdEnd = boxInteriorEnd(srcWidth, dstWidth) & ~1u;
+			uint32_t x = 0;
+			for (; x < simdEnd; x += 2)
+			{
+				__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+				__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+
+				// unpacking against zero splits a register into its two texels as 32 bit channels
+				__m128i sum0 = _mm_add_epi32(
+					_mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpackhi_epi16(a0, zero)),
+					_mm_add_epi32(_mm_unpacklo_epi16(b0, zero), _mm_unpackhi_epi16(b0, zero)));
+				__m128i sum1 = _mm_add_epi32(
+					_mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpackhi_epi16(a1, zero)),
+					_mm_add_epi32(_mm_unpacklo_epi16(b1, zero), _mm_unpackhi_epi16(b1, zero)));
+
+				sum0 = _mm_srli_epi32(_mm_add_epi32(sum0, round), 2);
+				sum1 = _mm_srli_epi32(_mm_add_epi32(sum1, round), 2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi32(sum0, sum1));
+			}
+			boxRowScalar(row0, row1, srcWidth, dst, x, dstWidth);
+		}
+
+		VTA_TARGET("sse4.1")
+		void kaiserColumnsSse41(const uint16_t* const rows[4], uint16_t* dst, uint32_t count)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[0] + i));
+				__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1] + i));
+				__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[2] + i));
+				__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[3] + i));
+
+				__m128i lo = kaiserTapsSse41(_mm_cvtepu16_epi32(r0), _mm_cvtepu16_epi32(r1), _mm_cvtepu16_epi32(r2), _mm_cvtepu16_epi32(r3));
+				__m128i hi = kaiserTapsSse41(_mm_unpackhi_epi16(r0, zero), _mm_unpackhi_epi16(r1, zero),
+					_mm_unpackhi_epi16(r2, zero), _mm_unpackhi_epi16(r3, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(lo, hi));
+			}
+			kaiserColumnsScalar(rows, dst, i, count);
+		}
+
+		// one output texel per iteration, its four taps are two unaligned loads of two texels each
+		VTA_TARGET("sse4.1")
+		void kaiserRowSse41(const uint16_t* src, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			uint32_t simdEnd = kaiserInteriorEnd(srcWidth, dstWidth);
+			kaiserRowScalar(src, srcWidth, dst, 0, 1);
+			for (uint32_t x = 1; x < simdEnd; x++)
+			{
+				__m128i ab = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (x * 2 - 1) * 4));
+				__m128i cd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (x * 2 + 1) * 4));
+				__m128i result = kaiserTapsSse41(
+					_mm_cvtepu16_epi32(ab), _mm_cvtepu16_epi32(_mm_srli_si128(ab, 8)),
+					_mm_cvtepu16_epi32(cd), _mm_cvtepu16_epi32(_mm_srli_si128(cd, 8)));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi32(result, result));
+			}
+			kaiserRowScalar(src, srcWidth, dst, std::max(simdEnd, 1u), dstWidth);
+		}
+
+		// four output texels per iteration. within each 128 bit lane the unpacks pair up texels 2x and 2x + 1,
+		// so one register ends up holding two finished outputs
+		VTA_TARGET("avx2")
+		void boxRowAvx2(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i round = _mm256_set1_epi32(2);
+			uint32_t simdEnd = boxInteriorEnd(srcWidth, dstWidth) & ~3u;
+			uint32_t x = 0;
+			for (; x < simdEnd; x += 4)
+			{
+				__m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8));
+				__m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8 + 16));
+				__m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8));
+				__m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8 + 16));
+
+				__m256i sum0 = _mm256_add_epi32(
+					_mm256_add_epi32(_mm256_unpacklo_epi16(a0, zero), _mm256_unpackhi_epi16(a0, zero)),
+					_mm256_add_epi32(_mm256_unpacklo_epi16(b0, zero), _mm256_unpackhi_epi16(b0, zero))); // outputs x | x + 1
+				__m256i sum1 = _mm256_add_epi32(
+					_mm256_add_epi32(_mm256_unpacklo_epi16(a1, zero), _mm256_unpackhi_epi16(a1, zero)),
+					_mm256_add_epi32(_mm256_unpacklo_epi16(b1, zero), _mm256_unpackhi_epi16(b1, zero))); // outputs x + 2 | x + 3
+
+				sum0 = _mm256_srli_epi32(_mm256_add_epi32(sum0, round), 2);
+				sum1 = _mm256_srli_epi32(_mm256_add_epi32(sum1, round), 2);
+
+				// packing works per lane and leaves x, x + 2, x + 1, x + 3
+				__m256i packed = _mm256_packus_epi32(sum0, sum1);
+				packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), packed);
+			}
+			boxRowScalar(row0, row1, srcWidth, dst, x, dstWidth);
+		}
+
+		VTA_TARGET("avx2")
+		inline __m256i kaiserTapsAvx2(__m256i a, __m256i b, __m256i c, __m256i d)
+		{
+			__m256i sum = _mm256_add_epi32(
+				_mm256_mullo_epi32(_mm256_add_epi32(a, d), _mm256_set1_epi32(KAISER_FAR)),
+				_mm256_mullo_epi32(_mm256_add_epi32(b, c), _mm256_set1_epi32(KAISER_NEAR)));
+			return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+		}
+
+		VTA_TARGET("avx2")
+		void kaiserColumnsAvx2(const uint16_t* const rows[4], uint16_t* dst, uint32_t count)
+		{
+			uint32_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i r0lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[0] + i));
+				__m128i r1lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1] + i));
+				__m128i r2lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[2] + i));
+				__m128i r3lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[3] + i));
+				__m128i r0hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[0] + i + 8));
+				__m128i r1hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1] + i + 8));
+				__m128i r2hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[2] + i + 8));
+				__m128i r3hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[3] + i + 8));
+
+				__m256i lo = kaiserTapsAvx2(_mm256_cvtepu16_epi32(r0lo), _mm256_cvtepu16_epi32(r1lo),
+					_mm256_cvtepu16_epi32(r2lo), _mm256_cvtepu16_epi32(r3lo));
+				__m256i hi = kaiserTapsAvx2(_mm256_cvtepu16_epi32(r0hi), _mm256_cvtepu16_epi32(r1hi),
+					_mm256_cvtepu16_epi32(r2hi), _mm256_cvtepu16_epi32(r3hi));
+
+				__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+			}
+			kaiserColumnsScalar(rows, dst, i, count);
+		}
+#endif
+
+#if defined(VTA_MIPGEN_NEON)
+		inline uint16x4_t kaiserTapsNeon(uint16x4_t a, uint16x4_t b, uint16x4_t c, uint16x4_t d)
+		{
+			uint32x4_t sum = vmulq_n_u32(vaddl_u16(a, d), KAISER_FAR);
+			sum = vmlaq_n_u32(sum, vaddl_u16(b, c), KAISER_NEAR);
+			return vrshrn_n_u32(sum, 8); // rounding narrow, same as (sum + 128) >> 8
+		}
+
+		void boxRowNeon(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			uint32_t simdEnd = boxInteriorEnd(srcWidth, dstWidth) & ~1u;
+			uint32_t x = 0;
+			for (; x < simdEnd; x += 2)
+			{
+				uint16x8_t a0 = vld1q_u16(row0 + x * 8);
+				uint16x8_t a1 = vld1q_u16(row0 + x * 8 + 8);
+				uint16x8_t b0 = vld1q_u16(row1 + x * 8);
+				uint16x8_t b1 = vld1q_u16(row1 + x * 8 + 8);
+
+				uint32x4_t sum0 = vaddq_u32(vaddl_u16(vget_low_u16(a0), vget_high_u16(a0)), vaddl_u16(vget_low_u16(b0), vget_high_u16(b0)));
+				uint32x4_t sum1 = vaddq_u32(vaddl_u16(vget_low_u16(a1), vget_high_u16(a1)), vaddl_u16(vget_low_u16(b1), vget_high_u16(b1)));
+				vst1q_u16(dst + x * 4, vcombine_u16(vrshrn_n_u32(sum0, 2), vrshrn_n_u32(sum1, 2)));
+			}
+			boxRowScalar(row0, row1, srcWidth, dst, x, dstWidth);
+		}
+
+		void kaiserColumnsNeon(const uint16_t* const rows[4], uint16_t* dst, uint32_t count)
+		{
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				uint16x8_t r0 = vld1q_u16(rows[0] + i);
+				uint16x8_t r1 = vld1q_u16(rows[1] + i);
+				uint16x8_t r2 = vld1q_u16(rows[2] + i);
+				uint16x8_t r3 = vld1q_u16(rows[3] + i);
+
+				uint16x4_t lo = kaiserTapsNeon(vget_low_u16(r0), vget_low_u16(r1), vget_low_u16(r2), vget_low_u16(r3));
+				uint16x4_t hi = kaiserTapsNeon(vget_high_u16(r0), vget_high_u16(r1), vget_high_u16(r2), vget_high_u16(r3));
+				vst1q_u16(dst + i, vcombine_u16(lo, hi));
+			}
+			kaiserColumnsScalar(rows, dst, i, count);
+		}
+
+		void kaiserRowNeon(const uint16_t* src, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth)
+		{
+			uint32_t simdEnd = kaiserInteriorEnd(srcWidth, dstWidth);
+			kaiserRowScalar(src, srcWidth, dst, 0, 1);
+			for (uint32_t x = 1; x < simdEnd; x++)
+			{
+				uint16x8_t ab = vld1q_u16(src + (x * 2 - 1) * 4);
+				uint16x8_t cd = vld1q_u16(src + (x * 2 + 1) * 4);
+				vst1_u16(dst + x * 4, kaiserTapsNeon(vget_low_u16(ab), vget_high_u16(ab), vget_low_u16(cd), vget_high_u16(cd)));
+			}
+			kaiserRowScalar(src, srcWidth, dst, std::max(simdEnd, 1u), dstWidth);
+		}
+#endif
+
+		struct Kernels
+		{
+			void (*boxRow)(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth);
+			void (*kaiserColumns)(const uint16_t* const rows[4], uint16_t* dst, uint32_t count); // vertical pass
+			void (*kaiserRow)(const uint16_t* src, uint32_t srcWidth, uint16_t* dst, uint32_t dstWidth); // horizontal pass
+		};
+
+		Kernels kernelsFor(MipGenerator::Isa isa)
+		{
+			switch (isa)
+			{
+#if defined(VTA_MIPGEN_X86)
+			case MipGenerator::Isa::AVX2:
+				return { boxRowAvx2, kaiserColumnsAvx2, kaiserRowSse41 }; // the horizontal pass is bound by its loads, not the width
+			case MipGenerator::Isa::SSE41:
+				return { boxRowSse41, kaiserColumnsSse41, kaiserRowSse41 };
+#endif
+#if defined(VTA_MIPGEN_NEON)
+			case MipGenerator::Isa::NEON:
+				return { boxRowNeon, kaiserColumnsNeon, kaiserRowNeon };
+#endif
+			default:
+				return { boxRowReference, kaiserColumnsReference, kaiserRowReference };
+			}
+		}
+
+		// splits rows into bands and runs them on the pool when there is enough work to go around
+		void forEachBand(VTA::VTAThreadPool* threadPool, uint32_t width, uint32_t height, const std::function<void(uint32_t, uint32_t)>& band)
+		{
+			uint32_t rowsPerBand = std::max(1u, MIN_TEXELS_PER_BAND / std::max(1u, width));
+			uint32_t bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+			auto runBand = [&](uint32_t i) { band(i * rowsPerBand, std::min(height, (i + 1) * rowsPerBand)); };
+
+			if (threadPool != nullptr && bandCount > 1)
+			{
+				threadPool->parallelFor(bandCount, runBand);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < bandCount; i++) runBand(i);
+			}
+		}
+	}
+
+	MipGenerator::MipGenerator(VTA::VTAThreadPool* threadPool, Isa isa) : threadPool{ threadPool }, isa{ isa } {}
+
+	MipGenerator::Isa MipGenerator::detectIsa()
+	{
+#if defined(VTA_MIPGEN_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		// avx2 also needs the OS to save the ymm registers
+		bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		bool avx2 = false;
+		if (osAvx && maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2) return Isa::AVX2;
+		if (sse41) return Isa::SSE41;
+		return Isa::Scalar;
+#elif defined(VTA_MIPGEN_NEON)
+		return Isa::NEON; // part of every aarch64 cpu
+#else
+		return Isa::Scalar;
+#endif
+	}
+
+	const char* MipGenerator::isaName(Isa isa)
+	{
+		switch (isa)
+		{
+		case Isa::SSE41: return "SSE4.1";
+		case Isa::AVX2: return "AVX2";
+		case Isa::NEON: return "NEON";
+		default: return "scalar";
+		}
+	}
+
+	void MipGenerator::generate(const std::vector<MipLevel>& levels, MipFilter filter, bool srgb) const
+	{
+		if (levels.size() < 2) return;
+
+		Kernels kernels = kernelsFor(isa);
+		const ColorTables& tables = colorTables();
+		const uint8_t* encodeColor = srgb ? tables.linearToSrgb : tables.linearToUnorm;
+
+		// the chain is filtered from 16 bit linear copies of each level, only the output goes back to 8 bit
+		std::vector<uint16_t> current(static_cast<size_t>(levels[0].width) * levels[0].height * 4);
+		std::vector<uint16_t> next;
+
+		forEachBand(threadPool, levels[0].width, levels[0].height, [&](uint32_t rowBegin, uint32_t rowEnd)
+			{
+				size_t begin = static_cast<size_t>(rowBegin) * levels[0].width * 4;
+				size_t end = static_cast<size_t>(rowEnd) * levels[0].width * 4;
+				for (size_t i = begin; i < end; i += 4)
+				{
+					const uint8_t* texel = levels[0].data + i;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						current[i + c] = srgb ? tables.srgbToLinear[texel[c]] : static_cast<uint16_t>(texel[c] * 257);
+					}
+					current[i + 3] = static_cast<uint16_t>(texel[3] * 257); // alpha is always linear
+				}
+			});
+
+		for (size_t level = 1; level < levels.size(); level++)
+		{
+			const MipLevel& src = levels[level - 1];
+			const MipLevel& dst = levels[level];
+			next.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+			forEachBand(threadPool, dst.width, dst.height, [&](uint32_t rowBegin, uint32_t rowEnd)
+				{
+					std::vector<uint16_t> columns; // kaiser vertical pass output, one source row wide
+					if (filter == MipFilter::Kaiser) columns.resize(static_cast<size_t>(src.width) * 4);
+
+					int32_t lastRow = static_cast<int32_t>(src.height) - 1;
+					auto srcRow = [&](int32_t y) { return current.data() + static_cast<size_t>(std::clamp(y, 0, lastRow)) * src.width * 4; };
+
+					for (uint32_t y = rowBegin; y < rowEnd; y++)
+					{
+						uint16_t* out = next.data() + static_cast<size_t>(y) * dst.width * 4;
+						int32_t base = static_cast<int32_t>(y) * 2;
+						if (filter == MipFilter::Kaiser)
+						{
+							const uint16_t* rows[4] = { srcRow(base - 1), srcRow(base), srcRow(base + 1), srcRow(base + 2) };
+							kernels.kaiserColumns(rows, columns.data(), src.width * 4);
+							kernels.kaiserRow(columns.data(), src.width, out, dst.width);
+						}
+						else
+						{
+							kernels.boxRow(srcRow(base), srcRow(base + 1), src.width, out, dst.width);
+						}
+
+						uint8_t* encoded = dst.data + static_cast<size_t>(y) * dst.width * 4;
+						for (uint32_t i = 0; i < dst.width * 4; i += 4)
+						{
+							encoded[i] = encodeColor[out[i]];
+							encoded[i + 1] = encodeColor[out[i + 1]];
+							encoded[i + 2] = encodeColor[out[i + 2]];
+							encoded[i + 3] = tables.linearToUnorm[out[i + 3]];
+						}
+					}
+				});
+
+			std::swap(current, next);
+		}
+	}
+
+	bool MipGenerator::benchmark(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, VTA::VTAThreadPool* threadPool)
+	{
+		// both runs get their own copy of the whole chain
+		std::vector<uint32_t> widths;
+		std::vector<uint32_t> heights;
+		size_t chainSize = 0;
+		for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+		{
+			widths.push_back(w);
+			heights.push_back(h);
+			chainSize += static_cast<size_t>(w) * h * 4;
+			if (w == 1 && h == 1) break;
+		}
+
+		std::vector<uint8_t> referenceChain(chainSize);
+		std::vector<uint8_t> optimizedChain(chainSize);
+		std::memcpy(referenceChain.data(), pixels, static_cast<size_t>(width) * height * 4);
+		std::memcpy(optimizedChain.data(), pixels, static_cast<size_t>(width) * height * 4);
+
+		auto levelsOf = [&](std::vector<uint8_t>& chain)
+		{
+			std::vector<MipLevel> levels;
+			size_t offset = 0;
+			for (size_t i = 0; i < widths.size(); i++)
+			{
+				levels.push_back({ chain.data() + offset, widths[i], heights[i] });
+				offset += static_cast<size_t>(widths[i]) * heights[i] * 4;
+			}
+			return levels;
+		};
+
+		auto time = [](const MipGenerator& generator, const std::vector<MipLevel>& levels, MipFilter filter)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			generator.generate(levels, filter, true);
+			return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+		};
+
+		MipGenerator reference{ nullptr, Isa::Scalar };
+		MipGenerator optimized{ threadPool, detectIsa() };
+		float referenceTime = time(reference, levelsOf(referenceChain), filter);
+		float optimizedTime = time(optimized, levelsOf(optimizedChain), filter);
+		bool identical = referenceChain == optimizedChain;
+
+		uint32_t threads = threadPool != nullptr ? threadPool->getThreadCount() + 1 : 1;
+		std::cout << "mip chain " << width << "x" << height << (filter == MipFilter::Kaiser ? " kaiser" : " box")
+			<< ": scalar " << referenceTime << " ms, " << isaName(optimized.isa) << " on " << threads << " threads " << optimizedTime << " ms, "
+			<< (identical ? "bit exact" : "MISMATCH") << std::endl;
+		return identical;
+	}
+}
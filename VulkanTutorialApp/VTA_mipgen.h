@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VTA_thread_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace VTA_Image
+{
+	enum class MipFilter
+	{
+		Box,    // 2x2 average
+		Kaiser, // 4x4 Kaiser windowed sinc, sharper than box at the same cost per output texel
+	};
+
+	// one tightly packed RGBA8 level, levels[i + 1] is expected to be half the size of levels[i] (at least 1)
+	struct MipLevel
+	{
+		uint8_t* data;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// Host side mip chain generation for formats the GPU can't blit and for offline baking.
+	// Filtering happens in linear space on 16 bit values, so sRGB textures don't darken down the chain.
+	// All the arithmetic is integer, which keeps every instruction set bit exact with the scalar reference.
+	class MipGenerator
+	{
+	public:
+		enum class Isa { Scalar, SSE41, AVX2, NEON };
+
+		// without a thread pool everything runs on the calling thread
+		explicit MipGenerator(VTA::VTAThreadPool* threadPool = nullptr, Isa isa = detectIsa());
+
+		// best instruction set the running CPU supports, out of the ones this build was compiled with
+		static Isa detectIsa();
+		static const char* isaName(Isa isa);
+
+		// levels[0] holds the decoded source, every other level is written from the one above it
+		void generate(const std::vector<MipLevel>& levels, MipFilter filter, bool srgb) const;
+
+		// builds the full chain of an image with the scalar reference and with the detected instruction set,
+		// logs both timings and returns whether the two chains match byte for byte
+		static bool benchmark(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, VTA::VTAThreadPool* threadPool);
+
+	private:
+		VTA::VTAThreadPool* threadPool;
+		Isa isa;
+	};
+}
@@ -33,6 +33,25 @@ namespace VTA
 		createVertexBuffers(builder.vertices);
 		vertexCount = static_cast<uint32_t>(builder.vertices.size());
 		createIndexBuffers(builder.indices);
+
+		// around the center of the bounds, not the tightest sphere but close enough for culling
+		if (!builder.vertices.empty())
+		{
+			glm::vec3 minimum = builder.vertices[0].position;
+			glm::vec3 maximum = minimum;
+			for (const Vertex& vertex : builder.vertices)
+			{
+				minimum = glm::min(minimum, vertex.position);
+				maximum = glm::max(maximum, vertex.position);
+			}
+			glm::vec3 center = (minimum + maximum) * 0.5f;
+			float radius = 0.f;
+			for (const Vertex& vertex : builder.vertices)
+			{
+				radius = glm::max(radius, glm::length(vertex.position - center));
+			}
+			boundingSphere = glm::vec4(center, radius);
+		}
 	}
 
 
@@ -55,7 +74,7 @@ namespace VTA
 		stagingBuffer.writeToBuffer((void*)vertices.data());
 
 		vertexBuffer = std::make_unique<VTABuffer>(device, vertexSize, vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			);
 
@@ -113,7 +132,7 @@ namespace VTA
 		stagingBuffer.writeToBuffer((void*)indices.data());
 
 		indexBuffer = std::make_unique<VTABuffer>(device, indexSize, indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
@@ -150,15 +169,15 @@ namespace VTA
 		vkFreeMemory(device.device(), stagingBufferMemory, nullptr);*/
 	}
 
-	void VTAModel::draw(VkCommandBuffer commandBuffer)
+	void VTAModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
 	{
 		if (hasIndexBuffer)
 		{
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0); // draw indexed model
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance); // draw indexed model
 		}
 		else 
 		{
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 		}
 
 		
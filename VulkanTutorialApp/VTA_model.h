@@ -6,6 +6,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan expects depth values to be in the range [0, 1]
 #include <glm/glm.hpp>
 #include "VTA_image.h"
+#include "VTA_texture_atlas.h"
 
 // std
 #include <memory>
@@ -52,10 +53,23 @@ namespace VTA
 
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		// instances come from whatever the vertex shader indexes with gl_InstanceIndex
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 		int textureDSindex;
+		uint32_t bindlessTextureIndex = 0; // slot in VTABindlessTextures, used instead of textureDSindex in bindless mode
+		bool inAtlas = false; // the texture is small enough for the atlas, atlasRegion is where it ended up
+		VTA_Image::AtlasRegion atlasRegion{}; // used instead of textureDSindex in atlas mode
+		VkDescriptorImageInfo textureInfo{}; // pushed per draw for textures that are neither bindless nor in the atlas
 		static std::unique_ptr<VTAModel> createModelFromFile(VTADevice& device, const std::string& filePath);
 
+		// for render systems that pack every model into shared buffers, both buffers can be copied from
+		VkBuffer getVertexBuffer() const { return vertexBuffer->getBuffer(); }
+		uint32_t getVertexCount() const { return vertexCount; }
+		VkBuffer getIndexBuffer() const { return hasIndexBuffer ? indexBuffer->getBuffer() : VK_NULL_HANDLE; }
+		uint32_t getIndexCount() const { return indexCount; }
+		// center in xyz and radius in w, in model space
+		const glm::vec4& getBoundingSphere() const { return boundingSphere; }
+
 	private:
 		VTADevice& device;
 
@@ -70,6 +84,8 @@ namespace VTA
 		uint32_t indexCount;
 
 		bool hasIndexBuffer = false;
+
+		glm::vec4 boundingSphere{ 0.f };
 		
 		void createVertexBuffers(const std::vector<Vertex> &vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
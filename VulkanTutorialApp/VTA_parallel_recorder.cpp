@@ -0,0 +1,128 @@
+#include "VTA_parallel_recorder.h"
+#include "VTA_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace VTA
+{
+	VTAParallelRecorder::VTAParallelRecorder(VTADevice& device, VTAThreadPool& threadPool, uint32_t minItemsPerSlot) :
+		device{ device }, threadPool{ threadPool }, minItemsPerSlot{ std::max(minItemsPerSlot, 1u) }
+	{
+		slotCount = threadPool.getThreadCount() + 1;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // reset as a whole, never buffer by buffer
+
+		framePools.resize(VTASwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& slots : framePools)
+		{
+			slots.resize(slotCount);
+			for (auto& slot : slots)
+			{
+				if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create secondary command pool!");
+				}
+			}
+		}
+	}
+
+	VTAParallelRecorder::~VTAParallelRecorder()
+	{
+		for (auto& slots : framePools)
+		{
+			for (auto& slot : slots)
+			{
+				vkDestroyCommandPool(device.device(), slot.commandPool, nullptr); // frees its command buffers too
+			}
+		}
+	}
+
+	void VTAParallelRecorder::beginFrame(int frameIndex, const SecondaryPassInfo& pass)
+	{
+		currentFrame = frameIndex;
+		this->pass = pass;
+		for (auto& slot : framePools[currentFrame])
+		{
+			vkResetCommandPool(device.device(), slot.commandPool, 0);
+			slot.used = 0;
+		}
+	}
+
+	VkCommandBuffer VTAParallelRecorder::beginSecondary(SlotPool& slot)
+	{
+		if (slot.used == slot.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = slot.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+			slot.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = slot.commandBuffers[slot.used++];
+
+		VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance{};
+		renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		renderingInheritance.colorAttachmentCount = static_cast<uint32_t>(pass.colorFormats.size());
+		renderingInheritance.pColorAttachmentFormats = pass.colorFormats.data();
+		renderingInheritance.depthAttachmentFormat = pass.depthFormat;
+		renderingInheritance.stencilAttachmentFormat = pass.stencilFormat;
+		renderingInheritance.rasterizationSamples = pass.samples;
+
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.pNext = pass.renderPass == VK_NULL_HANDLE ? &renderingInheritance : nullptr;
+		inheritance.renderPass = pass.renderPass;
+		inheritance.subpass = pass.subpass;
+		inheritance.framebuffer = pass.framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &pass.viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &pass.scissor);
+		return commandBuffer;
+	}
+
+	void VTAParallelRecorder::record(VkCommandBuffer primaryCommandBuffer, uint32_t itemCount, const RecordRange& recordRange)
+	{
+		uint32_t rangeCount = std::clamp((itemCount + minItemsPerSlot - 1) / minItemsPerSlot, 1u, slotCount);
+		std::vector<VkCommandBuffer> secondaries(rangeCount);
+
+		// range i always records with slot i's pool, so no pool is ever used by two threads at once
+		auto recordSlot = [&](uint32_t i)
+			{
+				uint32_t begin = static_cast<uint32_t>(uint64_t(itemCount) * i / rangeCount);
+				uint32_t end = static_cast<uint32_t>(uint64_t(itemCount) * (i + 1) / rangeCount);
+
+				VkCommandBuffer commandBuffer = beginSecondary(framePools[currentFrame][i]);
+				recordRange(commandBuffer, begin, end);
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+				secondaries[i] = commandBuffer;
+			};
+
+		threadPool.parallelFor(rangeCount, recordSlot); // a single range stays on this thread
+
+		vkCmdExecuteCommands(primaryCommandBuffer, rangeCount, secondaries.data());
+	}
+}
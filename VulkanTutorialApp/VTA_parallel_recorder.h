@@ -0,0 +1,70 @@
+#pragma once
+
+#include "VTA_device.hpp"
+#include "VTA_thread_pool.h"
+
+#include <functional>
+#include <vector>
+
+namespace VTA
+{
+	// the pass secondary command buffers are recorded for. Viewport and scissor aren't inherited, every secondary sets them
+	struct SecondaryPassInfo
+	{
+		VkRenderPass renderPass = VK_NULL_HANDLE; // null with dynamic rendering
+		uint32_t subpass = 0;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		std::vector<VkFormat> colorFormats; // only used with dynamic rendering
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkFormat stencilFormat = VK_FORMAT_UNDEFINED;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkViewport viewport{};
+		VkRect2D scissor{};
+	};
+
+	// Splits the draws of a pass across the thread pool. Each slot records a contiguous range of items into a secondary
+	// command buffer from its own command pool, one pool per slot and frame in flight, and the secondaries are executed
+	// from the primary in slot order, so the draw order is the same as recording everything on one thread.
+	// The pass has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, and then everything drawn in it
+	// goes through record.
+	class VTAParallelRecorder
+	{
+	public:
+		using RecordRange = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+		// ranges are never split below minItemsPerSlot, small passes end up in a single secondary
+		VTAParallelRecorder(VTADevice& device, VTAThreadPool& threadPool, uint32_t minItemsPerSlot = 512);
+		~VTAParallelRecorder();
+
+		VTAParallelRecorder(const VTAParallelRecorder&) = delete;
+		VTAParallelRecorder& operator=(const VTAParallelRecorder&) = delete;
+
+		// after beginFrame waited on the frame's fence. Resets the secondaries of frameIndex, pass is what this frame's inherit
+		void beginFrame(int frameIndex, const SecondaryPassInfo& pass);
+
+		// records [0, itemCount) and executes the result into primaryCommandBuffer. Secondaries start with nothing
+		// bound, recordRange binds the pipeline and descriptor sets it draws with. It runs on several threads at once
+		void record(VkCommandBuffer primaryCommandBuffer, uint32_t itemCount, const RecordRange& recordRange);
+
+		uint32_t getSlotCount() const { return slotCount; }
+
+	private:
+		struct SlotPool
+		{
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers; // allocated once, reused every time the frame comes around
+			uint32_t used = 0;
+		};
+
+		VkCommandBuffer beginSecondary(SlotPool& slot);
+
+		VTADevice& device;
+		VTAThreadPool& threadPool;
+		uint32_t minItemsPerSlot;
+		uint32_t slotCount; // the pool's workers and the calling thread
+
+		std::vector<std::vector<SlotPool>> framePools; // [frame][slot]
+		int currentFrame = 0;
+		SecondaryPassInfo pass;
+	};
+}
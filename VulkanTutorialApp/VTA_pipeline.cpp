@@ -1,11 +1,152 @@
 #include "VTA_pipeline.h"
-#include <fstream>
+#include <chrono>
 #include <stdexcept>
 #include <iostream>
 #include "VTA_model.h"
+#include "VTA_utils.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace VTA
 {
+    namespace
+    {
+        // non-dispatchable handles are pointers on 64 bit and integers on 32 bit platforms
+        template <typename T>
+        uint64_t handleKey(T handle)
+        {
+            return (uint64_t)handle;
+        }
+
+        // a config key is a flat list of 32 bit words, floats go in by their bits and handles as two words
+        void appendKey(std::vector<uint32_t>& key, uint32_t value)
+        {
+            key.push_back(value);
+        }
+
+        void appendKey(std::vector<uint32_t>& key, float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            key.push_back(bits);
+        }
+
+        void appendKey(std::vector<uint32_t>& key, uint64_t value)
+        {
+            key.push_back(static_cast<uint32_t>(value));
+            key.push_back(static_cast<uint32_t>(value >> 32));
+        }
+
+        template <typename T, typename U, typename... Rest>
+        void appendKey(std::vector<uint32_t>& key, T value, U next, Rest... rest)
+        {
+            appendKey(key, value);
+            appendKey(key, next, rest...);
+        }
+
+        // the classes a dynamic topology is allowed to move within
+        uint32_t topologyClass(VkPrimitiveTopology topology)
+        {
+            switch (topology)
+            {
+            case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+                return 0;
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+                return 1;
+            case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+                return 3;
+            default:
+                return 2;
+            }
+        }
+    }
+
+    // *************** Specialization Constants *********************
+
+    VTASpecializationConstants& VTASpecializationConstants::setBits(uint32_t constantId, uint32_t bits)
+    {
+        auto position = std::lower_bound(entries.begin(), entries.end(), constantId, [](const VkSpecializationMapEntry& entry, uint32_t id) {
+            return entry.constantID < id;
+            });
+        size_t index = static_cast<size_t>(position - entries.begin());
+        if (position != entries.end() && position->constantID == constantId)
+        {
+            data[index] = bits;
+            return *this;
+        }
+
+        entries.insert(position, VkSpecializationMapEntry{ constantId, 0, sizeof(uint32_t) });
+        data.insert(data.begin() + index, bits);
+        for (size_t i = index; i < entries.size(); i++)
+        {
+            entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+        }
+        return *this;
+    }
+
+    VTASpecializationConstants& VTASpecializationConstants::set(uint32_t constantId, uint32_t value)
+    {
+        return setBits(constantId, value);
+    }
+
+    VTASpecializationConstants& VTASpecializationConstants::set(uint32_t constantId, int32_t value)
+    {
+        return setBits(constantId, static_cast<uint32_t>(value));
+    }
+
+    VTASpecializationConstants& VTASpecializationConstants::set(uint32_t constantId, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return setBits(constantId, bits);
+    }
+
+    VTASpecializationConstants& VTASpecializationConstants::set(uint32_t constantId, bool value)
+    {
+        return setBits(constantId, value ? VK_TRUE : VK_FALSE);
+    }
+
+    VkSpecializationInfo VTASpecializationConstants::getInfo() const
+    {
+        VkSpecializationInfo info{};
+        info.mapEntryCount = static_cast<uint32_t>(entries.size());
+        info.pMapEntries = entries.data();
+        info.dataSize = data.size() * sizeof(uint32_t);
+        info.pData = data.data();
+        return info;
+    }
+
+    size_t VTASpecializationConstants::hash() const
+    {
+        size_t seed = 0;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            hashCombine(seed, entries[i].constantID, data[i]);
+        }
+        return seed;
+    }
+
+    bool VTASpecializationConstants::operator==(const VTASpecializationConstants& other) const
+    {
+        if (data != other.data || entries.size() != other.entries.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].constantID != other.entries[i].constantID)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // *************** Pipeline *********************
 
     
     VTAPipeline::VTAPipeline(VTADevice& device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo) : 
@@ -16,9 +157,9 @@ namespace VTA
 
     VTAPipeline::~VTAPipeline()
     {
-		vkDestroyShaderModule(VTAdevice.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(VTAdevice.device(), fragShaderModule, nullptr);
 		vkDestroyPipeline(VTAdevice.device(), graphicsPipeline, nullptr);
+		VTAdevice.shaderLibrary().release(*vertShader);
+		VTAdevice.shaderLibrary().release(*fragShader);
     }
 
     void VTAPipeline::bind(VkCommandBuffer commandBuffer)
@@ -124,50 +265,222 @@ namespace VTA
 
     }
 
-    std::vector<char> VTAPipeline::readFile(const std::string &filePath)
+    void VTAPipeline::setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget)
+    {
+        configInfo.renderPass = renderTarget.renderPass;
+        configInfo.subpass = renderTarget.subpass;
+        configInfo.colorAttachmentFormats = renderTarget.colorFormats;
+        configInfo.depthAttachmentFormat = renderTarget.depthFormat;
+        configInfo.stencilAttachmentFormat = renderTarget.stencilFormat;
+    }
+
+    void VTAPipeline::useDynamicRenderState(PipelineConfigInfo& configInfo, const VTADevice& device, const DynamicRenderState& state)
     {
-        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-        if (!file.is_open())
+        // the static values are what devices without the extensions get, and what the dynamic state starts from
+        enableAlphaBlending(configInfo);
+        configInfo.colorBlendAttachment.blendEnable = state.blendEnable ? VK_TRUE : VK_FALSE;
+        configInfo.rasterizationInfo.cullMode = state.cullMode;
+        configInfo.rasterizationInfo.frontFace = state.frontFace;
+        configInfo.rasterizationInfo.depthBiasEnable = state.depthBiasEnable ? VK_TRUE : VK_FALSE;
+        configInfo.inputAssemblyInfo.topology = state.topology;
+        configInfo.inputAssemblyInfo.primitiveRestartEnable = state.primitiveRestartEnable ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthTestEnable = state.depthTestEnable ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthWriteEnable = state.depthWriteEnable ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthCompareOp = state.depthCompareOp;
+
+        if (device.extendedDynamicStateSupported)
+        {
+            configInfo.dynamicStateEnables.insert(configInfo.dynamicStateEnables.end(), {
+                VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+                VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+                VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+                VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT });
+        }
+        if (device.extendedDynamicState2Supported)
         {
-            throw std::runtime_error("Failed to open file: " + filePath);
+            configInfo.dynamicStateEnables.insert(configInfo.dynamicStateEnables.end(), {
+                VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT,
+                VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT });
+        }
+        if (device.dynamicBlendEnableSupported)
+        {
+            configInfo.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
         }
 
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-        return buffer;
+        std::sort(configInfo.dynamicStateEnables.begin(), configInfo.dynamicStateEnables.end());
+        configInfo.dynamicStateEnables.erase(
+            std::unique(configInfo.dynamicStateEnables.begin(), configInfo.dynamicStateEnables.end()),
+            configInfo.dynamicStateEnables.end());
+        configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data(); // the vector may have moved
+        configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+    }
+
+    void VTAPipeline::setDynamicRenderState(VkCommandBuffer commandBuffer, const VTADevice& device, const DynamicRenderState& state)
+    {
+        if (device.extendedDynamicStateSupported)
+        {
+            device.cmdSetCullMode(commandBuffer, state.cullMode);
+            device.cmdSetFrontFace(commandBuffer, state.frontFace);
+            device.cmdSetPrimitiveTopology(commandBuffer, state.topology);
+            device.cmdSetDepthTestEnable(commandBuffer, state.depthTestEnable ? VK_TRUE : VK_FALSE);
+            device.cmdSetDepthWriteEnable(commandBuffer, state.depthWriteEnable ? VK_TRUE : VK_FALSE);
+            device.cmdSetDepthCompareOp(commandBuffer, state.depthCompareOp);
+        }
+        if (device.extendedDynamicState2Supported)
+        {
+            device.cmdSetDepthBiasEnable(commandBuffer, state.depthBiasEnable ? VK_TRUE : VK_FALSE);
+            device.cmdSetPrimitiveRestartEnable(commandBuffer, state.primitiveRestartEnable ? VK_TRUE : VK_FALSE);
+        }
+        if (device.dynamicBlendEnableSupported)
+        {
+            VkBool32 blendEnable = state.blendEnable ? VK_TRUE : VK_FALSE;
+            device.cmdSetColorBlendEnable(commandBuffer, 0, 1, &blendEnable);
+        }
+    }
+
+    void VTAPipeline::copyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst)
+    {
+        dst.bindingDescription = src.bindingDescription;
+        dst.attributeDescriptions = src.attributeDescriptions;
+        dst.viewportInfo = src.viewportInfo;
+        dst.inputAssemblyInfo = src.inputAssemblyInfo;
+        dst.rasterizationInfo = src.rasterizationInfo;
+        dst.multisampleInfo = src.multisampleInfo;
+        dst.colorBlendAttachment = src.colorBlendAttachment;
+        dst.colorBlendInfo = src.colorBlendInfo;
+        dst.depthStencilInfo = src.depthStencilInfo;
+        dst.dynamicStateEnables = src.dynamicStateEnables;
+        dst.dynamicStateInfo = src.dynamicStateInfo;
+        dst.pipelineLayout = src.pipelineLayout;
+        dst.renderPass = src.renderPass;
+        dst.subpass = src.subpass;
+        dst.colorAttachmentFormats = src.colorAttachmentFormats;
+        dst.depthAttachmentFormat = src.depthAttachmentFormat;
+        dst.stencilAttachmentFormat = src.stencilAttachmentFormat;
+        dst.flags = src.flags;
+        dst.specialization = src.specialization;
+
+        if (src.colorBlendInfo.pAttachments == &src.colorBlendAttachment)
+        {
+            dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+        }
+        if (src.dynamicStateInfo.pDynamicStates == src.dynamicStateEnables.data())
+        {
+            dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+        }
+    }
+
+    std::vector<uint32_t> VTAPipeline::pipelineConfigKey(const PipelineConfigInfo& configInfo)
+    {
+        // state set on the command buffer doesn't make a different pipeline, configs that only differ there share a variant
+        const VkDynamicState* dynamicBegin = configInfo.dynamicStateInfo.pDynamicStates;
+        const VkDynamicState* dynamicEnd = dynamicBegin ? dynamicBegin + configInfo.dynamicStateInfo.dynamicStateCount : nullptr;
+        auto keyed = [dynamicBegin, dynamicEnd](VkDynamicState state, uint32_t value) -> uint32_t
+        {
+            return std::find(dynamicBegin, dynamicEnd, state) != dynamicEnd ? 0 : value;
+        };
+
+        std::vector<uint32_t> key;
+        for (const auto& binding : configInfo.bindingDescription)
+        {
+            appendKey(key, binding.binding, binding.stride, static_cast<uint32_t>(binding.inputRate));
+        }
+        for (const auto& attribute : configInfo.attributeDescriptions)
+        {
+            appendKey(key, attribute.location, attribute.binding, static_cast<uint32_t>(attribute.format), attribute.offset);
+        }
+
+        const auto& inputAssembly = configInfo.inputAssemblyInfo;
+        appendKey(key,
+            keyed(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, static_cast<uint32_t>(inputAssembly.topology)),
+            topologyClass(inputAssembly.topology), // a dynamic topology still has to stay within its class
+            keyed(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT, inputAssembly.primitiveRestartEnable));
+
+        appendKey(key, configInfo.viewportInfo.viewportCount, configInfo.viewportInfo.scissorCount);
+
+        const auto& rasterization = configInfo.rasterizationInfo;
+        appendKey(key, rasterization.depthClampEnable, rasterization.rasterizerDiscardEnable,
+            static_cast<uint32_t>(rasterization.polygonMode),
+            keyed(VK_DYNAMIC_STATE_CULL_MODE_EXT, rasterization.cullMode),
+            keyed(VK_DYNAMIC_STATE_FRONT_FACE_EXT, static_cast<uint32_t>(rasterization.frontFace)),
+            keyed(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, rasterization.depthBiasEnable), rasterization.depthBiasConstantFactor, rasterization.depthBiasClamp,
+            rasterization.depthBiasSlopeFactor, rasterization.lineWidth);
+
+        const auto& multisample = configInfo.multisampleInfo;
+        appendKey(key, static_cast<uint32_t>(multisample.rasterizationSamples), multisample.sampleShadingEnable,
+            multisample.minSampleShading, multisample.alphaToCoverageEnable, multisample.alphaToOneEnable);
+
+        const auto& blend = configInfo.colorBlendInfo;
+        appendKey(key, blend.logicOpEnable, static_cast<uint32_t>(blend.logicOp), blend.attachmentCount,
+            blend.blendConstants[0], blend.blendConstants[1], blend.blendConstants[2], blend.blendConstants[3]);
+        for (uint32_t i = 0; i < blend.attachmentCount && blend.pAttachments; i++)
+        {
+            const auto& attachment = blend.pAttachments[i];
+            appendKey(key, keyed(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT, attachment.blendEnable),
+                static_cast<uint32_t>(attachment.srcColorBlendFactor), static_cast<uint32_t>(attachment.dstColorBlendFactor),
+                static_cast<uint32_t>(attachment.colorBlendOp), static_cast<uint32_t>(attachment.srcAlphaBlendFactor),
+                static_cast<uint32_t>(attachment.dstAlphaBlendFactor), static_cast<uint32_t>(attachment.alphaBlendOp),
+                attachment.colorWriteMask);
+        }
+
+        const auto& depthStencil = configInfo.depthStencilInfo;
+        appendKey(key,
+            keyed(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, depthStencil.depthTestEnable),
+            keyed(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, depthStencil.depthWriteEnable),
+            keyed(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT, static_cast<uint32_t>(depthStencil.depthCompareOp)),
+            depthStencil.depthBoundsTestEnable, depthStencil.stencilTestEnable, depthStencil.minDepthBounds, depthStencil.maxDepthBounds);
+        for (const VkStencilOpState* op : { &depthStencil.front, &depthStencil.back })
+        {
+            appendKey(key, static_cast<uint32_t>(op->failOp), static_cast<uint32_t>(op->passOp), static_cast<uint32_t>(op->depthFailOp),
+                static_cast<uint32_t>(op->compareOp), op->compareMask, op->writeMask, op->reference);
+        }
+
+        for (uint32_t i = 0; i < configInfo.dynamicStateInfo.dynamicStateCount; i++)
+        {
+            appendKey(key, static_cast<uint32_t>(configInfo.dynamicStateInfo.pDynamicStates[i]));
+        }
+
+        for (VkFormat format : configInfo.colorAttachmentFormats)
+        {
+            appendKey(key, static_cast<uint32_t>(format));
+        }
+        appendKey(key, static_cast<uint32_t>(configInfo.depthAttachmentFormat), static_cast<uint32_t>(configInfo.stencilAttachmentFormat));
+
+        appendKey(key, handleKey(configInfo.pipelineLayout), handleKey(configInfo.renderPass), configInfo.subpass, configInfo.flags);
+
+        VkSpecializationInfo specialization = configInfo.specialization.getInfo();
+        const auto* specializationData = static_cast<const uint32_t*>(specialization.pData);
+        for (uint32_t i = 0; i < specialization.mapEntryCount; i++)
+        {
+            appendKey(key, specialization.pMapEntries[i].constantID, specializationData[specialization.pMapEntries[i].offset / sizeof(uint32_t)]);
+        }
+        return key;
     }
 
     void VTAPipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
     {
-        auto vertCode = readFile(vertFilePath); // we are reading the compiled machine code
-        auto fragCode = readFile(fragFilePath);
+        VTAShaderLibrary& shaderLibrary = VTAdevice.shaderLibrary();
+        vertShader = &shaderLibrary.acquire(vertFilePath); // mapped compiled machine code, shared with other pipelines
+        fragShader = &shaderLibrary.acquire(fragFilePath);
 
-        std::cout << "Vertex shader code size: " << vertCode.size() << " bytes\n";
-        std::cout << "Fragment shader code size: " << fragCode.size() << " bytes\n";
+        std::cout << "Vertex shader code size: " << vertShader->codeSize << " bytes\n";
+        std::cout << "Fragment shader code size: " << fragShader->codeSize << " bytes\n";
 
-		createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
+        // the driver folds the constants in, so loops over them unroll and disabled branches disappear
+        VkSpecializationInfo specializationInfo = configInfo.specialization.getInfo();
+        const VkSpecializationInfo* pSpecializationInfo = configInfo.specialization.empty() ? nullptr : &specializationInfo;
 
+        VTAShaderLibrary::Stage stages[2];
         VkPipelineShaderStageCreateInfo shaderStages[2];
-		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
-		shaderStages[0].pName = "main"; // entry point of the shader    
-        shaderStages[0].flags = 0;
-		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
-
-        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = fragShaderModule;
-        shaderStages[1].pName = "main"; // entry point of the shader    
-        shaderStages[1].flags = 0;
-        shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
-
+        auto fillStages = [&](bool byIdentifier)
+        {
+            shaderLibrary.fillStage(*vertShader, VK_SHADER_STAGE_VERTEX_BIT, pSpecializationInfo, byIdentifier, stages[0]);
+            shaderLibrary.fillStage(*fragShader, VK_SHADER_STAGE_FRAGMENT_BIT, pSpecializationInfo, byIdentifier, stages[1]);
+            shaderStages[0] = stages[0].info; // the copies still chain into stages
+            shaderStages[1] = stages[1].info;
+        };
 
         auto& bindingDescriptions = configInfo.bindingDescription;
 		auto& attributeDescriptions = configInfo.attributeDescriptions;
@@ -181,6 +494,7 @@ namespace VTA
 
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.flags = configInfo.flags;
 		pipelineInfo.stageCount = 2;
 		pipelineInfo.pStages = shaderStages; // the programmable stages of the pipeline
         // next we need to wire up the pipeline create info to the config info
@@ -197,28 +511,97 @@ namespace VTA
 		pipelineInfo.renderPass = configInfo.renderPass;
 		pipelineInfo.subpass = configInfo.subpass;
 
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        if (configInfo.renderPass == VK_NULL_HANDLE)
+        {
+            // dynamic rendering, the pipeline only has to agree with the formats it will render into
+            renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+            renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+            renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+            renderingInfo.stencilAttachmentFormat = configInfo.stencilAttachmentFormat;
+            pipelineInfo.pNext = &renderingInfo;
+        }
+
         pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; 
 
-        if (vkCreateGraphicsPipelines(VTAdevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        auto start = std::chrono::high_resolution_clock::now();
+        VkResult result = VK_PIPELINE_COMPILE_REQUIRED_EXT;
+        if (shaderLibrary.usesIdentifiers())
+        {
+            // identifiers only work when the pipeline cache already holds this pipeline, otherwise the driver asks for the code
+            fillStages(true);
+            pipelineInfo.flags = configInfo.flags | VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+            result = vkCreateGraphicsPipelines(VTAdevice.device(), VTAdevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline);
+        }
+        if (result == VK_PIPELINE_COMPILE_REQUIRED_EXT)
+        {
+            fillStages(false);
+            pipelineInfo.flags = configInfo.flags;
+            result = vkCreateGraphicsPipelines(VTAdevice.device(), VTAdevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline);
+        }
+        if (result != VK_SUCCESS)
         {
+            shaderLibrary.release(*vertShader); // the destructor won't run
+            shaderLibrary.release(*fragShader);
 			throw std::runtime_error("failed to create graphics pipeline!");
         }
+        float creationMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        VTAdevice.pipelineCache().recordCreation(creationMs);
+
+    }
+
+    VTAComputePipeline::VTAComputePipeline(VTADevice& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout, const VkSpecializationInfo* specializationInfo,
+        VkPipelineCreateFlags flags) :
+        VTAdevice{ device }
+    {
+        VTAShaderLibrary& shaderLibrary = VTAdevice.shaderLibrary();
+        compShader = &shaderLibrary.acquire(compFilePath);
 
+        VTAShaderLibrary::Stage stage;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.flags = flags;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VkResult result = VK_PIPELINE_COMPILE_REQUIRED_EXT;
+        if (shaderLibrary.usesIdentifiers())
+        {
+            shaderLibrary.fillStage(*compShader, VK_SHADER_STAGE_COMPUTE_BIT, specializationInfo, true, stage);
+            pipelineInfo.stage = stage.info; // compute pipelines only have the one programmable stage
+            pipelineInfo.flags = flags | VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+            result = vkCreateComputePipelines(VTAdevice.device(), VTAdevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline);
+        }
+        if (result == VK_PIPELINE_COMPILE_REQUIRED_EXT)
+        {
+            shaderLibrary.fillStage(*compShader, VK_SHADER_STAGE_COMPUTE_BIT, specializationInfo, false, stage);
+            pipelineInfo.stage = stage.info;
+            pipelineInfo.flags = flags;
+            result = vkCreateComputePipelines(VTAdevice.device(), VTAdevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline);
+        }
+        if (result != VK_SUCCESS)
+        {
+            shaderLibrary.release(*compShader);
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        float creationMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        VTAdevice.pipelineCache().recordCreation(creationMs);
     }
 
-    void VTAPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
+    VTAComputePipeline::~VTAComputePipeline()
     {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-		
-        if (vkCreateShaderModule(VTAdevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create shader module!");
-		}
+        vkDestroyPipeline(VTAdevice.device(), computePipeline, nullptr);
+        VTAdevice.shaderLibrary().release(*compShader);
     }
 
+    void VTAComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
 
-} 
\ No newline at end of file
+}
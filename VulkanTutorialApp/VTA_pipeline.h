@@ -5,6 +5,59 @@
 
 namespace VTA
 {
+    // values for the constant_id declarations of a pipeline's shaders. Every constant is 32 bits (int, uint,
+    // float or VkBool32), ids a stage doesn't declare are ignored by it. Entries are kept sorted by id, so the
+    // order of the set calls doesn't change the variant.
+    class VTASpecializationConstants
+    {
+        public:
+        VTASpecializationConstants& set(uint32_t constantId, uint32_t value);
+        VTASpecializationConstants& set(uint32_t constantId, int32_t value);
+        VTASpecializationConstants& set(uint32_t constantId, float value);
+        VTASpecializationConstants& set(uint32_t constantId, bool value); // stored as a VkBool32
+
+        bool empty() const { return entries.empty(); }
+
+        // points into this object, only valid while it is alive and unchanged
+        VkSpecializationInfo getInfo() const;
+
+        size_t hash() const;
+        bool operator==(const VTASpecializationConstants& other) const;
+
+        private:
+        VTASpecializationConstants& setBits(uint32_t constantId, uint32_t bits);
+
+        std::vector<VkSpecializationMapEntry> entries; // sorted by constantID, entry i is at offset 4 * i
+        std::vector<uint32_t> data;
+    };
+
+    // what pipelines draw into. With a render pass the formats are ignored, without one (dynamic rendering)
+    // only the formats matter, so pipelines don't have to be rebuilt when the attachments are recreated
+    struct RenderTargetInfo
+    {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+        std::vector<VkFormat> colorFormats;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+        VkFormat stencilFormat = VK_FORMAT_UNDEFINED;
+    };
+
+    // fixed function state that the extended dynamic state extensions move onto the command buffer. Whatever the device
+    // can set dynamically is left out of the pipeline (and out of its variant key), the rest is baked in from here.
+    // Topology can only change within its class (list, strip, fan...) on devices without unrestricted topology.
+    struct DynamicRenderState
+    {
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+        VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        bool primitiveRestartEnable = false;
+        bool depthTestEnable = true;
+        bool depthWriteEnable = true;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+        bool depthBiasEnable = false;
+        bool blendEnable = false; // the equation is always the one from enableAlphaBlending
+    };
+
     struct PipelineConfigInfo {
 		PipelineConfigInfo() = default;
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -23,8 +76,13 @@ namespace VTA
         std::vector<VkDynamicState> dynamicStateEnables;
         VkPipelineDynamicStateCreateInfo dynamicStateInfo;
         VkPipelineLayout pipelineLayout = nullptr;
-        VkRenderPass renderPass = nullptr;
+        VkRenderPass renderPass = nullptr; // null for dynamic rendering, the attachment formats below are used instead
         uint32_t subpass = 0;
+        std::vector<VkFormat> colorAttachmentFormats;
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+        VkFormat stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+        VkPipelineCreateFlags flags = 0;
+        VTASpecializationConstants specialization; // handed to both stages
     };
 
 
@@ -43,20 +101,47 @@ namespace VTA
 
          static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo, VkSampleCountFlagBits msaaSamples);
          static void enableAlphaBlending(PipelineConfigInfo& configInfo);
+         static void setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget);
+         // bakes state into configInfo and marks every part of it the device can change at draw time as dynamic
+         static void useDynamicRenderState(PipelineConfigInfo& configInfo, const VTADevice& device, const DynamicRenderState& state);
+         // after binding a pipeline made with useDynamicRenderState, sets the parts it left dynamic
+         static void setDynamicRenderState(VkCommandBuffer commandBuffer, const VTADevice& device, const DynamicRenderState& state);
+         // PipelineConfigInfo points into itself, a plain member copy would leave dst pointing at src
+         static void copyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
+         // every state that ends up in the pipeline as a list of words, the layout and render pass handles and the
+         // specialization constants included. Two configs with equal keys build the same variant
+         static std::vector<uint32_t> pipelineConfigKey(const PipelineConfigInfo& configInfo);
            
 
          private:
-         static std::vector<char> readFile(const std::string& filePath);
 
          void createGraphicsPipeline(const std::string& vertFilePath, 
                                     const std::string& fragFilePath, 
                                     const PipelineConfigInfo& configInfo);
 
-		 void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-         
          VTADevice& VTAdevice;
          VkPipeline graphicsPipeline;
-		 VkShaderModule vertShaderModule;
-         VkShaderModule fragShaderModule;
+         const VTAShaderLibrary::Shader* vertShader; // acquired from the device's shader library
+         const VTAShaderLibrary::Shader* fragShader;
+    };
+
+    class VTAComputePipeline
+    {
+         public:
+         VTAComputePipeline(VTADevice& device,
+                    const std::string& compFilePath,
+                    VkPipelineLayout pipelineLayout,
+                    const VkSpecializationInfo* specializationInfo = nullptr,
+                    VkPipelineCreateFlags flags = 0);
+         ~VTAComputePipeline();
+         VTAComputePipeline(const VTAComputePipeline&) = delete;
+         VTAComputePipeline& operator=(const VTAComputePipeline&) = delete;
+
+         void bind(VkCommandBuffer commandBuffer);
+
+         private:
+         VTADevice& VTAdevice;
+         VkPipeline computePipeline;
+         const VTAShaderLibrary::Shader* compShader;
     };
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "VTA_pipeline_cache.h"
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace VTA
+{
+    VTAPipelineCache::VTAPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string filePath) :
+        device{ device }, properties{ properties }, filePath{ std::move(filePath) }
+    {
+        std::vector<char> initialData;
+        std::ifstream file{ this->filePath, std::ios::ate | std::ios::binary };
+        if (file.is_open())
+        {
+            initialData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(initialData.data(), initialData.size());
+        }
+
+        loadedFromDisk = validateHeader(initialData);
+        if (!loadedFromDisk)
+        {
+            initialData.clear(); // stale or foreign data would only be rejected by the driver, start cold instead
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = initialData.size();
+        cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+
+        if (loadedFromDisk)
+        {
+            std::cout << "pipeline cache: warm, " << initialData.size() << " bytes from " << this->filePath << std::endl;
+        }
+        else
+        {
+            std::cout << "pipeline cache: cold" << std::endl;
+        }
+    }
+
+    VTAPipelineCache::~VTAPipelineCache()
+    {
+        double totalMs = creationMicroseconds.load() / 1000.0;
+        std::cout << "pipeline cache (" << (loadedFromDisk ? "warm" : "cold") << "): " << pipelinesCreated.load()
+            << " pipelines created in " << totalMs << " ms" << std::endl;
+
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    }
+
+    bool VTAPipelineCache::validateHeader(const std::vector<char>& data) const
+    {
+        if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+        {
+            return false;
+        }
+
+        VkPipelineCacheHeaderVersionOne header;
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+            header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID &&
+            std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void VTAPipelineCache::save() const
+    {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+        {
+            return;
+        }
+
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+        {
+            std::cerr << "failed to read pipeline cache data, not saving it" << std::endl;
+            return;
+        }
+
+        // write next to the real file, then swap it in with a rename. The data is on disk before the rename, otherwise
+        // a crash right after it can leave an empty file under the real name
+        std::string tempPath = filePath + ".tmp";
+        std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+        bool written = file != nullptr && std::fwrite(data.data(), 1, dataSize, file) == dataSize && std::fflush(file) == 0;
+#if defined(__linux__)
+        written = written && fsync(fileno(file)) == 0;
+#elif defined(_WIN32)
+        written = written && _commit(_fileno(file)) == 0;
+#endif
+        if (file != nullptr && std::fclose(file) != 0) written = false;
+        if (!written)
+        {
+            std::cerr << "failed to write pipeline cache to " << tempPath << std::endl;
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, filePath, error);
+        if (error)
+        {
+            std::cerr << "failed to replace pipeline cache " << filePath << ": " << error.message() << std::endl;
+            std::filesystem::remove(tempPath, error);
+        }
+    }
+
+    void VTAPipelineCache::recordCreation(double milliseconds)
+    {
+        pipelinesCreated++;
+        creationMicroseconds += static_cast<uint64_t>(milliseconds * 1000.0);
+    }
+}
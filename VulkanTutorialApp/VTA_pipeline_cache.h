@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VTA
+{
+    // Device wide VkPipelineCache that survives restarts. The file is only used when its header matches the
+    // current vendor, device and driver cache UUID, anything else starts cold. save() writes to a temporary file
+    // and renames it over the old one, so a crash mid-write never leaves a truncated cache behind.
+    class VTAPipelineCache
+    {
+        public:
+        VTAPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string filePath);
+        ~VTAPipelineCache();
+
+        VTAPipelineCache(const VTAPipelineCache&) = delete;
+        VTAPipelineCache& operator=(const VTAPipelineCache&) = delete;
+
+        VkPipelineCache getPipelineCache() const { return pipelineCache; }
+        bool isWarm() const { return loadedFromDisk; }
+
+        void save() const;
+
+        // pipelines report their creation time so cold and warm starts can be compared
+        void recordCreation(double milliseconds);
+
+        private:
+        bool validateHeader(const std::vector<char>& data) const;
+
+        VkDevice device;
+        const VkPhysicalDeviceProperties& properties;
+        std::string filePath;
+        VkPipelineCache pipelineCache;
+        bool loadedFromDisk = false;
+
+        std::atomic<uint32_t> pipelinesCreated{ 0 };
+        std::atomic<uint64_t> creationMicroseconds{ 0 };
+    };
+}
@@ -0,0 +1,262 @@
+#include "VTA_pipeline_compiler.h"
+#include "VTA_swap_chain.hpp"
+#include "VTA_utils.h"
+
+// std
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace VTA
+{
+    // *************** Handle *********************
+
+    bool VTAPipelineCompiler::Handle::isReady() const
+    {
+        return state && state->stage.load(std::memory_order_acquire) == Ready;
+    }
+
+    bool VTAPipelineCompiler::Handle::hasFailed() const
+    {
+        return state && state->stage.load(std::memory_order_acquire) == Failed;
+    }
+
+    bool VTAPipelineCompiler::Handle::bindState(const State& state, VkCommandBuffer commandBuffer)
+    {
+        // the worker publishes a pipeline before it moves the stage past it, so the acquire makes it visible here
+        int stage = state.stage.load(std::memory_order_acquire);
+        if (stage == Ready)
+        {
+            state.pipeline->bind(commandBuffer);
+            return true;
+        }
+        if (state.fallback && bindState(*state.fallback, commandBuffer))
+        {
+            return true;
+        }
+        if (stage == Placeholder || (stage == Failed && state.placeholder))
+        {
+            state.placeholder->bind(commandBuffer);
+            return true;
+        }
+        return false;
+    }
+
+    bool VTAPipelineCompiler::Handle::bind(VkCommandBuffer commandBuffer) const
+    {
+        return state && bindState(*state, commandBuffer);
+    }
+
+    bool VTAPipelineCompiler::Handle::wait() const
+    {
+        if (!state)
+        {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock{ state->mutex };
+        state->finished.wait(lock, [this]() {
+            int stage = state->stage.load(std::memory_order_acquire);
+            return (stage == Ready || stage == Failed) && state->reloadsRunning == 0;
+            });
+        return state->stage.load(std::memory_order_acquire) == Ready;
+    }
+
+    // *************** Compiler *********************
+
+    bool VTAPipelineCompiler::VariantKey::operator==(const VariantKey& other) const
+    {
+        return config == other.config && vertFilePath == other.vertFilePath && fragFilePath == other.fragFilePath;
+    }
+
+    size_t VTAPipelineCompiler::VariantKeyHash::operator()(const VariantKey& key) const
+    {
+        size_t seed = 0;
+        for (uint32_t word : key.config)
+        {
+            hashCombine(seed, word);
+        }
+        hashCombine(seed, key.vertFilePath, key.fragFilePath);
+        return seed;
+    }
+
+    VTAPipelineCompiler::VTAPipelineCompiler(VTADevice& device, VTAThreadPool& threadPool) : device{ device }, threadPool{ threadPool }
+    {
+    }
+
+    VTAPipelineCompiler::~VTAPipelineCompiler()
+    {
+        std::unique_lock<std::mutex> lock{ pendingMutex };
+        pendingDone.wait(lock, [this]() { return pending.load() == 0; });
+
+        std::cout << "pipeline compiler: " << stats.variantsCompiled << " variants compiled, " << stats.variantHits << " reused, "
+            << stats.variantsReloaded << " reloaded" << std::endl;
+    }
+
+    VTAPipelineCompiler::Stats VTAPipelineCompiler::getStats() const
+    {
+        std::lock_guard<std::mutex> lock{ variantMutex };
+        return stats;
+    }
+
+    void VTAPipelineCompiler::finish(Handle::State& state, Handle::Stage stage)
+    {
+        {
+            std::lock_guard<std::mutex> lock{ state.mutex };
+            state.stage.store(stage, std::memory_order_release);
+        }
+        state.finished.notify_all();
+    }
+
+    void VTAPipelineCompiler::taskDone()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ pendingMutex };
+            pending--;
+        }
+        pendingDone.notify_all();
+    }
+
+    VTAPipelineCompiler::Handle VTAPipelineCompiler::compile(
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo,
+        const Handle& fallback)
+    {
+        VariantKey key{ vertFilePath, fragFilePath, VTAPipeline::pipelineConfigKey(configInfo) };
+
+        std::lock_guard<std::mutex> variantLock{ variantMutex };
+        auto found = variants.find(key);
+        if (found != variants.end() && !found->second.hasFailed())
+        {
+            stats.variantHits++;
+            return found->second;
+        }
+        stats.variantsCompiled++; // a failed variant is tried again, the shader may have been fixed since
+
+        auto state = std::make_shared<Handle::State>();
+        state->fallback = fallback.state;
+        state->vertFilePath = vertFilePath;
+        state->fragFilePath = fragFilePath;
+
+        // the task outlives the caller's config, it gets its own
+        auto config = std::make_shared<PipelineConfigInfo>();
+        VTAPipeline::copyPipelineConfigInfo(configInfo, *config);
+        state->config = config;
+
+        pending++;
+        threadPool.submit([this, state, config, vertFilePath, fragFilePath]()
+            {
+                try
+                {
+                    if (!state->fallback)
+                    {
+                        // a quick unoptimized build to draw with while the real one compiles
+                        config->flags |= VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+                        state->placeholder = std::make_unique<VTAPipeline>(device, vertFilePath, fragFilePath, *config);
+                        state->stage.store(Handle::Placeholder, std::memory_order_release);
+                        config->flags &= ~VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+                    }
+
+                    state->pipeline = std::make_unique<VTAPipeline>(device, vertFilePath, fragFilePath, *config);
+                    finish(*state, Handle::Ready);
+                }
+                catch (...)
+                {
+                    std::cerr << "failed to compile pipeline " << vertFilePath << " + " << fragFilePath << std::endl;
+                    state->error = std::current_exception();
+                    finish(*state, Handle::Failed);
+                }
+                taskDone();
+            });
+
+        Handle handle{ state };
+        variants.insert_or_assign(std::move(key), handle);
+        return handle;
+    }
+
+    void VTAPipelineCompiler::reload(const std::string& shaderFilePath)
+    {
+        // the watcher may spell the path differently ("./x.spv" against "x.spv")
+        std::filesystem::path changed = std::filesystem::path(shaderFilePath).lexically_normal();
+
+        std::lock_guard<std::mutex> variantLock{ variantMutex };
+        for (auto& kv : variants)
+        {
+            std::shared_ptr<Handle::State> state = kv.second.state;
+            if (std::filesystem::path(state->vertFilePath).lexically_normal() != changed &&
+                std::filesystem::path(state->fragFilePath).lexically_normal() != changed)
+            {
+                continue;
+            }
+            if (state->stage.load(std::memory_order_acquire) < Handle::Ready)
+            {
+                continue; // the first compile hasn't read its shaders yet, or is still using the config
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{ state->mutex };
+                state->reloadsRunning++; // keeps wait() from returning while the layout is still needed
+            }
+            stats.variantsReloaded++;
+
+            pending++;
+            threadPool.submit([this, state]()
+                {
+                    try
+                    {
+                        // the shader library keys by content, the changed file comes back as a new shader
+                        auto pipeline = std::make_unique<VTAPipeline>(device, state->vertFilePath, state->fragFilePath, *state->config);
+                        std::lock_guard<std::mutex> lock{ reloadMutex };
+                        state->reloaded = std::move(pipeline); // a later reload finishing first is simply replaced
+                        reloadsDone.push_back(state);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        // the old pipeline stays, fixing the shader triggers the next attempt
+                        std::cerr << "failed to reload pipeline " << state->vertFilePath << " + " << state->fragFilePath << ": " << e.what() << std::endl;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock{ state->mutex };
+                        state->reloadsRunning--;
+                    }
+                    state->finished.notify_all();
+                    taskDone();
+                });
+        }
+    }
+
+    void VTAPipelineCompiler::applyReloads()
+    {
+        // every call is one more fence waited on, after MAX_FRAMES_IN_FLIGHT of them no frame can still bind the pipeline
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [](RetiredPipeline& old) {
+            return --old.framesLeft == 0;
+            }), retired.end());
+
+        std::vector<std::shared_ptr<Handle::State>> done;
+        {
+            std::lock_guard<std::mutex> lock{ reloadMutex };
+            done.swap(reloadsDone);
+        }
+
+        for (const auto& state : done)
+        {
+            std::unique_ptr<VTAPipeline> pipeline;
+            {
+                std::lock_guard<std::mutex> lock{ reloadMutex };
+                pipeline = std::move(state->reloaded);
+            }
+            if (!pipeline)
+            {
+                continue; // queued twice, the first entry already swapped it
+            }
+
+            if (state->pipeline)
+            {
+                retired.push_back(RetiredPipeline{ std::move(state->pipeline), VTASwapChain::MAX_FRAMES_IN_FLIGHT });
+            }
+            state->pipeline = std::move(pipeline);
+            finish(*state, Handle::Ready); // a variant that failed before is usable again
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "VTA_pipeline.h"
+#include "VTA_thread_pool.h"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VTA
+{
+    // Builds graphics pipelines on the thread pool so render systems never stall on the driver compiler.
+    // compile() returns straight away with a handle; until the pipeline is ready, bind() falls back to the
+    // fallback handle if one was given, or else to an unoptimized build of the same pipeline that the worker
+    // compiles first (VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT). With neither ready, bind() binds nothing
+    // and returns false, and the caller skips its draws for that frame.
+    // Pipelines are kept per variant: the same shaders with the same config (specialization constants included)
+    // get the handle of the first compile back. Variants are keyed by the layout and render pass handles too, so
+    // they are only meaningful while those are alive.
+    // reload() builds every variant of a changed shader again in the background. The old pipelines keep drawing
+    // until applyReloads() swaps the new ones in at a frame boundary, and are destroyed once no frame can use them.
+    class VTAPipelineCompiler
+    {
+        public:
+        class Handle
+        {
+            public:
+            Handle() = default;
+
+            bool isReady() const;
+            bool hasFailed() const;
+
+            // binds the best pipeline available right now, false when there is none yet
+            bool bind(VkCommandBuffer commandBuffer) const;
+
+            // blocks until the compile and any reload of it are finished, true when it succeeded
+            bool wait() const;
+
+            explicit operator bool() const { return state != nullptr; }
+
+            private:
+            friend class VTAPipelineCompiler;
+
+            enum Stage : int
+            {
+                Pending = 0,
+                Placeholder = 1, // the unoptimized build is usable
+                Ready = 2,
+                Failed = 3,
+            };
+
+            struct State
+            {
+                std::atomic<int> stage{ Pending };
+                std::unique_ptr<VTAPipeline> placeholder; // kept until the handle goes, a frame in flight may still use it
+                std::unique_ptr<VTAPipeline> pipeline;
+                std::exception_ptr error;
+                std::shared_ptr<State> fallback;
+
+                // what the variant was built from, a reload builds it again with the new shader code
+                std::string vertFilePath;
+                std::string fragFilePath;
+                std::shared_ptr<PipelineConfigInfo> config;
+                std::unique_ptr<VTAPipeline> reloaded; // guarded by the compiler's reloadMutex until it is swapped in
+                uint32_t reloadsRunning = 0;           // guarded by mutex
+
+                mutable std::mutex mutex;
+                mutable std::condition_variable finished;
+            };
+
+            explicit Handle(std::shared_ptr<State> state) : state{ std::move(state) } {}
+
+            static bool bindState(const State& state, VkCommandBuffer commandBuffer);
+
+            std::shared_ptr<State> state;
+        };
+
+        VTAPipelineCompiler(VTADevice& device, VTAThreadPool& threadPool);
+        ~VTAPipelineCompiler(); // waits for every compile still running
+
+        VTAPipelineCompiler(const VTAPipelineCompiler&) = delete;
+        VTAPipelineCompiler& operator=(const VTAPipelineCompiler&) = delete;
+
+        struct Stats
+        {
+            uint32_t variantHits = 0;
+            uint32_t variantsCompiled = 0;
+            uint32_t variantsReloaded = 0;
+        };
+
+        // configInfo is copied, its pipeline layout and render pass have to outlive the compile.
+        // fallback only matters when the variant is new
+        Handle compile(
+            const std::string& vertFilePath,
+            const std::string& fragFilePath,
+            const PipelineConfigInfo& configInfo,
+            const Handle& fallback = Handle{});
+
+        // thread safe, shaderFilePath is the SPIR-V file that changed
+        void reload(const std::string& shaderFilePath);
+        // on the main thread between frames, after beginFrame waited on the frame's fence and before any recording
+        void applyReloads();
+
+        uint32_t getPendingCount() const { return pending.load(); }
+        Stats getStats() const;
+
+        private:
+        struct VariantKey
+        {
+            std::string vertFilePath;
+            std::string fragFilePath;
+            std::vector<uint32_t> config; // VTAPipeline::pipelineConfigKey, compared word for word
+
+            bool operator==(const VariantKey& other) const;
+        };
+
+        struct VariantKeyHash
+        {
+            size_t operator()(const VariantKey& key) const;
+        };
+
+        struct RetiredPipeline
+        {
+            std::unique_ptr<VTAPipeline> pipeline;
+            uint32_t framesLeft; // applyReloads calls until no frame in flight can still have it bound
+        };
+
+        void finish(Handle::State& state, Handle::Stage stage);
+        void taskDone();
+
+        VTADevice& device;
+        VTAThreadPool& threadPool;
+
+        std::atomic<uint32_t> pending{ 0 };
+        std::mutex pendingMutex;
+        std::condition_variable pendingDone;
+
+        mutable std::mutex variantMutex;
+        std::unordered_map<VariantKey, Handle, VariantKeyHash> variants; // keeps every variant alive until the compiler goes
+        Stats stats{};
+
+        std::mutex reloadMutex;
+        std::vector<std::shared_ptr<Handle::State>> reloadsDone;
+        std::vector<RetiredPipeline> retired; // main thread only
+    };
+}
@@ -5,6 +5,30 @@
 
 namespace VTA
 {
+	namespace
+	{
+		bool hasStencilComponent(VkFormat format)
+		{
+			return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+		}
+
+		VkImageMemoryBarrier layoutBarrier(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+			return barrier;
+		}
+	}
+
 	struct SimplePushConstantsData
 	{
 		glm::mat2 transform{ 1.f };
@@ -52,6 +76,46 @@ namespace VTA
 	}
 
 
+	RenderTargetInfo VTARenderer::getSwapChainRenderTarget() const
+	{
+		RenderTargetInfo renderTarget{};
+		renderTarget.renderPass = swapChain->getRenderPass(); // null with dynamic rendering
+		renderTarget.colorFormats = { swapChain->getSwapChainImageFormat() };
+		renderTarget.depthFormat = swapChain->getDepthFormat();
+		return renderTarget;
+	}
+
+	SecondaryPassInfo VTARenderer::getSecondaryPassInfo() const
+	{
+		assert(isFrameStarted && "The framebuffer is only known once the frame has started");
+
+		SecondaryPassInfo pass{};
+		if (!swapChain->usesDynamicRendering())
+		{
+			pass.renderPass = swapChain->getRenderPass();
+			pass.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+		}
+		pass.colorFormats = { swapChain->getSwapChainImageFormat() };
+		pass.depthFormat = swapChain->getDepthFormat();
+		// beginDynamicRendering only attaches depth, the stencil format stays undefined like in the pipelines
+		pass.samples = device.msaaSamples;
+		pass.viewport = getSwapChainViewport();
+		pass.scissor = { {0, 0}, swapChain->getSwapChainExtent() };
+		return pass;
+	}
+
+	VkViewport VTARenderer::getSwapChainViewport() const
+	{
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
+		viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		return viewport;
+	}
+
 	VkCommandBuffer VTARenderer::beginFrame()
 	{
 		assert(!isFrameStarted && "Cannot call beginFrame while a frame is already in progress.");
@@ -113,36 +177,41 @@ namespace VTA
 		currentFrameIndex = (currentFrameIndex + 1) % VTASwapChain::MAX_FRAMES_IN_FLIGHT; 
 	}
 
-	void VTARenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void VTARenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "Cannot call beginSwapChainRenderPass when frame is not in progress.");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
 
+		if (swapChain->usesDynamicRendering())
+		{
+			beginDynamicRendering(commandBuffer, contents);
+		}
+		else
+		{
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = swapChain->getRenderPass();
+			renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex); // which frame buffer is this render pass writing to?
+			renderPassInfo.renderArea.offset = { 0, 0 }; // where to start rendering
+			renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent(); // swap chain extent can sometime be larger than the window extent
+			std::array<VkClearValue, 2> clearValues{};
+			clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+			//in our render pass we structured our attachments so that the first attachment is the color attachment and the second attachment is the depth attachment
+
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents); // inline means that we are not using secondary command buffers
+		}
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = swapChain->getRenderPass();
-		renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex); // which frame buffer is this render pass writing to?
-		renderPassInfo.renderArea.offset = { 0, 0 }; // where to start rendering
-		renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent(); // swap chain extent can sometime be larger than the window extent
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-		//in our render pass we structured our attachments so that the first attachment is the color attachment and the second attachment is the depth attachment
-
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // inline means that we are not using secondary command buffers
+		if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+		{
+			return; // nothing but vkCmdExecuteCommands is allowed in the pass now, and secondaries set their own viewport
+		}
 
 		// dynamically setup viewport and scissor
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-		viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+		VkViewport viewport = getSwapChainViewport();
 		VkRect2D scissor{ {0, 0}, swapChain->getSwapChainExtent() };
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
@@ -153,9 +222,99 @@ namespace VTA
 		assert(isFrameStarted && "Cannot call endSwapChainRenderPass when frame is not in progress.");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
 
+		if (swapChain->usesDynamicRendering())
+		{
+			endDynamicRendering(commandBuffer);
+			return;
+		}
 		vkCmdEndRenderPass(commandBuffer); // end the render pass
 	}
 
+	void VTARenderer::beginDynamicRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		// without a render pass the layout transitions are ours. Nothing is loaded, so every attachment starts from UNDEFINED
+		bool multisampled = device.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+		VkFormat depthFormat = swapChain->getDepthFormat();
+		VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+		std::array<VkImageMemoryBarrier, 3> barriers{
+			layoutBarrier(swapChain->getImage(currentImageIndex), VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+			layoutBarrier(swapChain->getDepthImage(), depthAspect,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT),
+			layoutBarrier(swapChain->getColorImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+		};
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			multisampled ? 3 : 2, barriers.data());
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.clearValue.color = { 0.01f, 0.01f, 0.01f, 1.0f };
+		if (multisampled)
+		{
+			// same as the resolve attachment of the render pass, only the resolved swap chain image is kept
+			colorAttachment.imageView = swapChain->getColorImageView();
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			colorAttachment.resolveImageView = swapChain->getImageView(currentImageIndex);
+			colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+		else
+		{
+			colorAttachment.imageView = swapChain->getImageView(currentImageIndex);
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		}
+
+		VkRenderingAttachmentInfoKHR depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		depthAttachment.imageView = swapChain->getDepthImageView();
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+		{
+			renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+		}
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = swapChain->getSwapChainExtent();
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		device.cmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void VTARenderer::endDynamicRendering(VkCommandBuffer commandBuffer)
+	{
+		device.cmdEndRendering(commandBuffer);
+
+		// what the render pass did through finalLayout
+		VkImageMemoryBarrier presentBarrier = layoutBarrier(swapChain->getImage(currentImageIndex), VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0);
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &presentBarrier);
+	}
+
 	void VTARenderer::freeCommandBuffers()
 	{
 		vkFreeCommandBuffers(device.device(), device.getCommandPool(), static_cast<float>(commandBuffers.size()), commandBuffers.data());
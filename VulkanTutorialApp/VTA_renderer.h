@@ -4,6 +4,8 @@
 #include "VTA_device.hpp"
 #include "VTA_swap_chain.hpp"
 #include "VTA_model.h"
+#include "VTA_pipeline.h"
+#include "VTA_parallel_recorder.h"
 
 #include <memory>
 #include <vector>
@@ -26,6 +28,9 @@ namespace VTA
 			return swapChain->getRenderPass();
 		}
 
+		// render pass or attachment formats, whichever the swap chain renders with
+		RenderTargetInfo getSwapChainRenderTarget() const;
+
 		float getAspectRatio() const { return swapChain->extentAspectRatio(); }
 
 		bool isFrameUnProgress() { return isFrameStarted; }
@@ -37,9 +42,13 @@ namespace VTA
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS everything in the pass is recorded through a VTAParallelRecorder
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// what secondaries recorded into this frame's swap chain pass inherit
+		SecondaryPassInfo getSecondaryPassInfo() const;
+
 		int getFrameIndex() const
 		{
 			assert(isFrameStarted && "Cannot get frame index when frame is not in progress.");
@@ -53,6 +62,9 @@ namespace VTA
 		void freeCommandBuffers();
 		void createCommandBuffers();
 		void recreateSwapChain();
+		void beginDynamicRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents);
+		VkViewport getSwapChainViewport() const;
+		void endDynamicRendering(VkCommandBuffer commandBuffer);
 
 
 
@@ -0,0 +1,241 @@
+#include "VTA_shader_library.h"
+
+// std
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VTA
+{
+    namespace
+    {
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    }
+
+    // *************** Mapped File *********************
+
+#ifdef _WIN32
+    VTAShaderLibrary::MappedFile::MappedFile(const std::string& filePath)
+    {
+        // delete sharing lets the shader watcher rename a recompiled file over this one
+        HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("Failed to open file: " + filePath);
+        }
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file, &size);
+        fileSize = static_cast<size_t>(size.QuadPart);
+
+        // the view keeps the mapping alive, neither handle is needed once it exists
+        HANDLE mapping = fileSize > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            throw std::runtime_error("failed to map file: " + filePath);
+        }
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr)
+        {
+            throw std::runtime_error("failed to map file: " + filePath);
+        }
+    }
+
+    VTAShaderLibrary::MappedFile::~MappedFile()
+    {
+        UnmapViewOfFile(view);
+    }
+#else
+    VTAShaderLibrary::MappedFile::MappedFile(const std::string& filePath)
+    {
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open file: " + filePath);
+        }
+
+        struct stat fileStat{};
+        fstat(fd, &fileStat);
+        fileSize = static_cast<size_t>(fileStat.st_size);
+
+        // the mapping outlives the descriptor
+        void* mapped = fileSize > 0 ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            throw std::runtime_error("failed to map file: " + filePath);
+        }
+        view = mapped;
+    }
+
+    VTAShaderLibrary::MappedFile::~MappedFile()
+    {
+        munmap(const_cast<void*>(view), fileSize);
+    }
+#endif
+
+    // *************** Shader Library *********************
+
+    VTAShaderLibrary::VTAShaderLibrary(VkDevice device, bool inlineCodeSupported, PFN_vkGetShaderModuleCreateInfoIdentifierEXT getIdentifier) :
+        device{ device }, inlineCodeSupported{ inlineCodeSupported }, getIdentifier{ getIdentifier }
+    {
+    }
+
+    VTAShaderLibrary::~VTAShaderLibrary()
+    {
+        // anything left here was never released, the device is going away regardless
+        for (auto& kv : shaders)
+        {
+            if (kv.second.shader->module != VK_NULL_HANDLE)
+            {
+                vkDestroyShaderModule(device, kv.second.shader->module, nullptr);
+            }
+        }
+    }
+
+    uint64_t VTAShaderLibrary::hashCode(const uint32_t* code, size_t wordCount)
+    {
+        // FNV-1a over the words, the same SPIR-V always lands on the same key
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < wordCount; i++)
+        {
+            hash ^= code[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    const VTAShaderLibrary::Shader& VTAShaderLibrary::acquire(const std::string& filePath)
+    {
+        // mapping and hashing happen outside the lock, the pipeline compiler acquires from several threads
+        auto file = std::make_unique<MappedFile>(filePath);
+        if (file->size() % sizeof(uint32_t) != 0 || file->size() < 5 * sizeof(uint32_t))
+        {
+            throw std::runtime_error("SPIR-V file has an invalid size: " + filePath);
+        }
+        const uint32_t* code = static_cast<const uint32_t*>(file->data()); // mappings are page aligned
+        if (code[0] != SPIRV_MAGIC)
+        {
+            throw std::runtime_error("not a SPIR-V file: " + filePath);
+        }
+        uint64_t hash = hashCode(code, file->size() / sizeof(uint32_t));
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        stats.filesMapped++;
+
+        auto found = shaders.find(hash);
+        if (found != shaders.end())
+        {
+            Shader& shader = *found->second.shader;
+            if (shader.codeSize != file->size() || std::memcmp(shader.code, code, shader.codeSize) != 0)
+            {
+                throw std::runtime_error("shader hash collision: " + filePath);
+            }
+            found->second.refCount++;
+            stats.contentHits++;
+            return shader; // the new mapping goes away with file
+        }
+
+        auto shader = std::make_unique<Shader>();
+        shader->hash = hash;
+        shader->code = code;
+        shader->codeSize = file->size();
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = shader->codeSize;
+        moduleInfo.pCode = shader->code;
+
+        if (getIdentifier)
+        {
+            // computed from the create info, no module has to exist for it
+            shader->identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+            getIdentifier(device, &moduleInfo, &shader->identifier);
+        }
+
+        if (!inlineCodeSupported)
+        {
+            if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shader->module) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create shader module!");
+            }
+            stats.modulesCreated++;
+        }
+
+        Shader& stored = *shader;
+        shaders.emplace(hash, Entry{ std::move(file), std::move(shader), 1 });
+        return stored;
+    }
+
+    void VTAShaderLibrary::release(const Shader& shader)
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto found = shaders.find(shader.hash);
+        assert(found != shaders.end() && "Releasing a shader that was not acquired from this library");
+        if (--found->second.refCount > 0)
+        {
+            return;
+        }
+
+        if (found->second.shader->module != VK_NULL_HANDLE)
+        {
+            vkDestroyShaderModule(device, found->second.shader->module, nullptr);
+        }
+        shaders.erase(found);
+    }
+
+    void VTAShaderLibrary::fillStage(
+        const Shader& shader,
+        VkShaderStageFlagBits stageFlag,
+        const VkSpecializationInfo* specializationInfo,
+        bool byIdentifier,
+        Stage& stage) const
+    {
+        stage = Stage{};
+        stage.info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.info.stage = stageFlag;
+        stage.info.pName = "main"; // entry point of the shader
+        stage.info.pSpecializationInfo = specializationInfo;
+
+        if (byIdentifier && shader.identifier.identifierSize > 0)
+        {
+            stage.identifier.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+            stage.identifier.identifierSize = shader.identifier.identifierSize;
+            stage.identifier.pIdentifier = shader.identifier.identifier;
+            stage.info.pNext = &stage.identifier;
+        }
+        else if (shader.module == VK_NULL_HANDLE)
+        {
+            // VK_KHR_maintenance5, the create info is chained where the module would be
+            stage.inlineCode.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            stage.inlineCode.codeSize = shader.codeSize;
+            stage.inlineCode.pCode = shader.code;
+            stage.info.pNext = &stage.inlineCode;
+        }
+        else
+        {
+            stage.info.module = shader.module;
+        }
+    }
+
+    VTAShaderLibrary::Stats VTAShaderLibrary::getStats() const
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        Stats current = stats;
+        current.shadersAlive = static_cast<uint32_t>(shaders.size());
+        return current;
+    }
+}
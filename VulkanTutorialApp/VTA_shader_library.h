@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace VTA
+{
+    // Device wide store of SPIR-V, keyed by a hash of the file contents. Files are memory mapped instead of read,
+    // and a shader used by several pipelines, or sitting at several paths, is loaded once and reference counted.
+    // With VK_KHR_maintenance5 the mapped code goes straight into the pipeline and no VkShaderModule exists at all.
+    // With VK_EXT_shader_module_identifier pipelines can also be created from the identifier alone, which skips the
+    // code entirely when the pipeline cache already holds the pipeline.
+    class VTAShaderLibrary
+    {
+        public:
+        struct Shader
+        {
+            uint64_t hash;
+            const uint32_t* code; // mapped, stays valid as long as the shader is acquired
+            size_t codeSize;      // in bytes
+            VkShaderModule module = VK_NULL_HANDLE; // only created when the code can't be passed inline
+            VkShaderModuleIdentifierEXT identifier{}; // identifierSize stays 0 without VK_EXT_shader_module_identifier
+        };
+
+        // everything one pipeline stage points at. It points into itself, keep it in place after fillStage
+        struct Stage
+        {
+            VkPipelineShaderStageCreateInfo info{};
+            VkShaderModuleCreateInfo inlineCode{};
+            VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifier{};
+        };
+
+        struct Stats
+        {
+            uint32_t filesMapped = 0;
+            uint32_t contentHits = 0;    // acquires served by a shader that was already loaded
+            uint32_t modulesCreated = 0;
+            uint32_t shadersAlive = 0;
+        };
+
+        // getIdentifier is null when VK_EXT_shader_module_identifier is not enabled
+        VTAShaderLibrary(VkDevice device, bool inlineCodeSupported, PFN_vkGetShaderModuleCreateInfoIdentifierEXT getIdentifier);
+        ~VTAShaderLibrary();
+
+        VTAShaderLibrary(const VTAShaderLibrary&) = delete;
+        VTAShaderLibrary& operator=(const VTAShaderLibrary&) = delete;
+
+        // every acquire is paired with a release of the shader it returned
+        const Shader& acquire(const std::string& filePath);
+        void release(const Shader& shader);
+
+        bool usesIdentifiers() const { return getIdentifier != nullptr; }
+
+        // byIdentifier is only valid for pipelines created with VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT,
+        // on VK_PIPELINE_COMPILE_REQUIRED fill the stages again without it
+        void fillStage(
+            const Shader& shader,
+            VkShaderStageFlagBits stageFlag,
+            const VkSpecializationInfo* specializationInfo,
+            bool byIdentifier,
+            Stage& stage) const;
+
+        Stats getStats() const;
+
+        private:
+        // read only view of a whole file, the handles are closed right after mapping
+        class MappedFile
+        {
+            public:
+            explicit MappedFile(const std::string& filePath);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const void* data() const { return view; }
+            size_t size() const { return fileSize; }
+
+            private:
+            const void* view = nullptr;
+            size_t fileSize = 0;
+        };
+
+        struct Entry
+        {
+            std::unique_ptr<MappedFile> file;
+            std::unique_ptr<Shader> shader; // handed out by reference, so it must not move with the map
+            uint32_t refCount;
+        };
+
+        static uint64_t hashCode(const uint32_t* code, size_t wordCount);
+
+        VkDevice device;
+        bool inlineCodeSupported;
+        PFN_vkGetShaderModuleCreateInfoIdentifierEXT getIdentifier;
+
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, Entry> shaders;
+
+        Stats stats{};
+    };
+}
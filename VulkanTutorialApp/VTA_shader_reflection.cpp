@@ -0,0 +1,492 @@
+#include "VTA_shader_reflection.h"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace VTA
+{
+    namespace
+    {
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+        constexpr uint32_t HEADER_WORDS = 5;
+
+        // the handful of SPIR-V enumerants reflection needs, values from the SPIR-V specification
+        namespace Op
+        {
+            constexpr uint32_t EntryPoint = 15;
+            constexpr uint32_t TypeBool = 20;
+            constexpr uint32_t TypeInt = 21;
+            constexpr uint32_t TypeFloat = 22;
+            constexpr uint32_t TypeVector = 23;
+            constexpr uint32_t TypeMatrix = 24;
+            constexpr uint32_t TypeImage = 25;
+            constexpr uint32_t TypeSampler = 26;
+            constexpr uint32_t TypeSampledImage = 27;
+            constexpr uint32_t TypeArray = 28;
+            constexpr uint32_t TypeRuntimeArray = 29;
+            constexpr uint32_t TypeStruct = 30;
+            constexpr uint32_t TypePointer = 32;
+            constexpr uint32_t Constant = 43;
+            constexpr uint32_t SpecConstant = 50;
+            constexpr uint32_t Function = 54;
+            constexpr uint32_t FunctionEnd = 56;
+            constexpr uint32_t Variable = 59;
+            constexpr uint32_t Decorate = 71;
+            constexpr uint32_t MemberDecorate = 72;
+            constexpr uint32_t TypeAccelerationStructure = 5341;
+        }
+
+        namespace Decoration
+        {
+            constexpr uint32_t Block = 2;
+            constexpr uint32_t BufferBlock = 3;
+            constexpr uint32_t ArrayStride = 6;
+            constexpr uint32_t MatrixStride = 7;
+            constexpr uint32_t BuiltIn = 11;
+            constexpr uint32_t Location = 30;
+            constexpr uint32_t Binding = 33;
+            constexpr uint32_t DescriptorSet = 34;
+            constexpr uint32_t Offset = 35;
+        }
+
+        namespace StorageClass
+        {
+            constexpr uint32_t UniformConstant = 0;
+            constexpr uint32_t Input = 1;
+            constexpr uint32_t Uniform = 2;
+            constexpr uint32_t PushConstant = 9;
+            constexpr uint32_t StorageBuffer = 12;
+        }
+
+        constexpr uint32_t DIM_BUFFER = 5;
+        constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+        VkShaderStageFlagBits toStage(uint32_t executionModel)
+        {
+            switch (executionModel)
+            {
+            case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+            case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+            case 5364: return VK_SHADER_STAGE_TASK_BIT_EXT;
+            case 5365: return VK_SHADER_STAGE_MESH_BIT_EXT;
+            default:
+                throw std::runtime_error("unsupported SPIR-V execution model " + std::to_string(executionModel));
+            }
+        }
+
+        // one pass over the instruction stream, keeping only what the queries below look at
+        struct Module
+        {
+            const uint32_t* code;
+            size_t wordCount;
+
+            VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+            std::unordered_map<uint32_t, const uint32_t*> types;      // result id to its instruction
+            std::unordered_map<uint32_t, uint32_t> constants;         // 32 bit scalar constants, spec constants at their default
+            std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations;
+            std::unordered_map<uint64_t, std::unordered_map<uint32_t, uint32_t>> memberDecorations; // (struct << 32) | member
+            std::vector<const uint32_t*> variables;
+            std::unordered_set<uint32_t> referenced; // every id some function operand names
+
+            Module(const uint32_t* code, size_t codeSize) : code{ code }, wordCount{ codeSize / sizeof(uint32_t) }
+            {
+                if (codeSize % sizeof(uint32_t) != 0 || wordCount < HEADER_WORDS || code[0] != SPIRV_MAGIC)
+                {
+                    throw std::runtime_error("failed to reflect shader, not a SPIR-V module!");
+                }
+
+                bool hasEntryPoint = false;
+                bool inFunction = false;
+                for (size_t offset = HEADER_WORDS; offset < wordCount;)
+                {
+                    const uint32_t* instruction = code + offset;
+                    uint32_t length = instruction[0] >> 16;
+                    uint32_t opcode = instruction[0] & 0xffff;
+                    if (length == 0 || offset + length > wordCount)
+                    {
+                        throw std::runtime_error("failed to reflect shader, truncated SPIR-V instruction!");
+                    }
+                    offset += length;
+
+                    if (inFunction)
+                    {
+                        // literals can collide with ids, which at worst keeps an unused resource in the layout
+                        for (uint32_t i = 1; i < length; i++)
+                        {
+                            referenced.insert(instruction[i]);
+                        }
+                        inFunction = opcode != Op::FunctionEnd;
+                        continue;
+                    }
+
+                    switch (opcode)
+                    {
+                    case Op::EntryPoint:
+                        if (hasEntryPoint)
+                        {
+                            throw std::runtime_error("failed to reflect shader, modules with several entry points are not supported!");
+                        }
+                        stage = toStage(instruction[1]);
+                        hasEntryPoint = true;
+                        break;
+                    case Op::TypeBool:
+                    case Op::TypeInt:
+                    case Op::TypeFloat:
+                    case Op::TypeVector:
+                    case Op::TypeMatrix:
+                    case Op::TypeImage:
+                    case Op::TypeSampler:
+                    case Op::TypeSampledImage:
+                    case Op::TypeArray:
+                    case Op::TypeRuntimeArray:
+                    case Op::TypeStruct:
+                    case Op::TypePointer:
+                    case Op::TypeAccelerationStructure:
+                        types[instruction[1]] = instruction;
+                        break;
+                    case Op::Constant:
+                    case Op::SpecConstant:
+                        constants[instruction[2]] = instruction[3];
+                        break;
+                    case Op::Variable:
+                        variables.push_back(instruction);
+                        break;
+                    case Op::Decorate:
+                        decorations[instruction[1]][instruction[2]] = length > 3 ? instruction[3] : 0;
+                        break;
+                    case Op::MemberDecorate:
+                        memberDecorations[(uint64_t(instruction[1]) << 32) | instruction[2]][instruction[3]] = length > 4 ? instruction[4] : 0;
+                        break;
+                    case Op::Function:
+                        inFunction = true;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+
+                if (!hasEntryPoint)
+                {
+                    throw std::runtime_error("failed to reflect shader, the module has no entry point!");
+                }
+            }
+
+            const uint32_t* type(uint32_t id) const
+            {
+                auto found = types.find(id);
+                if (found == types.end())
+                {
+                    throw std::runtime_error("failed to reflect shader, unknown type id " + std::to_string(id));
+                }
+                return found->second;
+            }
+
+            const uint32_t* decoration(uint32_t id, uint32_t kind) const
+            {
+                auto found = decorations.find(id);
+                if (found == decorations.end()) return nullptr;
+                auto value = found->second.find(kind);
+                return value == found->second.end() ? nullptr : &value->second;
+            }
+
+            const uint32_t* memberDecoration(uint32_t structId, uint32_t member, uint32_t kind) const
+            {
+                auto found = memberDecorations.find((uint64_t(structId) << 32) | member);
+                if (found == memberDecorations.end()) return nullptr;
+                auto value = found->second.find(kind);
+                return value == found->second.end() ? nullptr : &value->second;
+            }
+
+            uint32_t arrayLength(const uint32_t* arrayType) const
+            {
+                auto found = constants.find(arrayType[3]);
+                if (found == constants.end())
+                {
+                    throw std::runtime_error("failed to reflect shader, array length is not a constant!");
+                }
+                return found->second;
+            }
+
+            // bytes a value of the type takes in an explicitly laid out block, matrixStride comes from the member
+            uint32_t size(uint32_t typeId, uint32_t matrixStride = 0) const
+            {
+                const uint32_t* instruction = type(typeId);
+                switch (instruction[0] & 0xffff)
+                {
+                case Op::TypeBool:
+                    return 4;
+                case Op::TypeInt:
+                case Op::TypeFloat:
+                    return instruction[2] / 8;
+                case Op::TypeVector:
+                    return instruction[3] * size(instruction[2]);
+                case Op::TypeMatrix:
+                    return instruction[3] * (matrixStride ? matrixStride : size(instruction[2]));
+                case Op::TypeArray:
+                {
+                    const uint32_t* stride = decoration(typeId, Decoration::ArrayStride);
+                    return arrayLength(instruction) * (stride ? *stride : size(instruction[2], matrixStride));
+                }
+                case Op::TypeRuntimeArray:
+                    return 0;
+                case Op::TypeStruct:
+                {
+                    uint32_t end = 0;
+                    uint32_t memberCount = (instruction[0] >> 16) - 2;
+                    for (uint32_t member = 0; member < memberCount; member++)
+                    {
+                        const uint32_t* offset = memberDecoration(typeId, member, Decoration::Offset);
+                        const uint32_t* stride = memberDecoration(typeId, member, Decoration::MatrixStride);
+                        end = std::max(end, (offset ? *offset : end) + size(instruction[2 + member], stride ? *stride : 0));
+                    }
+                    return end;
+                }
+                default:
+                    throw std::runtime_error("failed to reflect shader, type has no size!");
+                }
+            }
+
+            VkDescriptorType descriptorType(uint32_t typeId, uint32_t storageClass) const
+            {
+                const uint32_t* instruction = type(typeId);
+                switch (instruction[0] & 0xffff)
+                {
+                case Op::TypeStruct:
+                    if (storageClass == StorageClass::StorageBuffer || decoration(typeId, Decoration::BufferBlock))
+                    {
+                        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    }
+                    return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                case Op::TypeSampler:
+                    return VK_DESCRIPTOR_TYPE_SAMPLER;
+                case Op::TypeSampledImage:
+                    return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                case Op::TypeImage:
+                {
+                    uint32_t dim = instruction[3];
+                    bool storage = instruction[7] == 2; // 1 is sampled, 2 is read/write without a sampler
+                    if (dim == DIM_BUFFER) return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                    if (dim == DIM_SUBPASS_DATA) return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                case Op::TypeAccelerationStructure:
+                    return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+                default:
+                    throw std::runtime_error("failed to reflect shader, unsupported descriptor type!");
+                }
+            }
+
+            VkFormat vertexFormat(uint32_t typeId) const
+            {
+                const uint32_t* instruction = type(typeId);
+                uint32_t components = 1;
+                if ((instruction[0] & 0xffff) == Op::TypeVector)
+                {
+                    components = instruction[3];
+                    instruction = type(instruction[2]);
+                }
+                uint32_t opcode = instruction[0] & 0xffff;
+                if ((opcode != Op::TypeFloat && opcode != Op::TypeInt) || instruction[2] != 32 || components > 4)
+                {
+                    return VK_FORMAT_UNDEFINED;
+                }
+
+                static constexpr VkFormat floats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+                static constexpr VkFormat ints[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+                static constexpr VkFormat uints[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+                if (opcode == Op::TypeFloat) return floats[components - 1];
+                return instruction[3] ? ints[components - 1] : uints[components - 1];
+            }
+        };
+    }
+
+    VTAShaderReflection::VTAShaderReflection(VTAShaderLibrary& shaderLibrary, std::initializer_list<std::string> filePaths)
+    {
+        for (const std::string& filePath : filePaths)
+        {
+            const VTAShaderLibrary::Shader& shader = shaderLibrary.acquire(filePath);
+            try
+            {
+                addStage(shader);
+            }
+            catch (...)
+            {
+                shaderLibrary.release(shader);
+                throw;
+            }
+            shaderLibrary.release(shader);
+        }
+    }
+
+    void VTAShaderReflection::addStage(const uint32_t* code, size_t codeSize)
+    {
+        Module module{ code, codeSize };
+        stages |= module.stage;
+
+        for (const uint32_t* variable : module.variables)
+        {
+            uint32_t id = variable[2];
+            uint32_t storageClass = variable[3];
+            if (!module.referenced.count(id)) continue; // declared, but no function of this stage touches it
+
+            const uint32_t* pointer = module.type(variable[1]);
+            uint32_t typeId = pointer[3];
+
+            if (storageClass == StorageClass::PushConstant)
+            {
+                // the block's members carry explicit offsets, the range spans from the first to the end of the last
+                const uint32_t* block = module.type(typeId);
+                uint32_t memberCount = (block[0] >> 16) - 2;
+                uint32_t begin = UINT32_MAX;
+                for (uint32_t member = 0; member < memberCount; member++)
+                {
+                    const uint32_t* offset = module.memberDecoration(typeId, member, Decoration::Offset);
+                    begin = std::min(begin, offset ? *offset : 0);
+                }
+                begin = memberCount > 0 ? begin & ~3u : 0;
+                uint32_t end = (module.size(typeId) + 3) & ~3u;
+
+                if (hasPushConstants())
+                {
+                    end = std::max(end, pushConstantRange.offset + pushConstantRange.size);
+                    begin = std::min(begin, pushConstantRange.offset);
+                }
+                pushConstantRange.stageFlags |= module.stage;
+                pushConstantRange.offset = begin;
+                pushConstantRange.size = end - begin;
+                continue;
+            }
+
+            if (storageClass == StorageClass::Input)
+            {
+                const uint32_t* location = module.decoration(id, Decoration::Location);
+                if (module.stage != VK_SHADER_STAGE_VERTEX_BIT || !location || module.decoration(id, Decoration::BuiltIn)) continue;
+
+                // a matrix input takes one location per column
+                const uint32_t* inputType = module.type(typeId);
+                uint32_t locations = 1;
+                if ((inputType[0] & 0xffff) == Op::TypeMatrix)
+                {
+                    locations = inputType[3];
+                    typeId = inputType[2];
+                }
+                for (uint32_t i = 0; i < locations; i++)
+                {
+                    vertexInputs.push_back(VertexInput{ *location + i, module.vertexFormat(typeId) });
+                }
+                continue;
+            }
+
+            if (storageClass != StorageClass::UniformConstant && storageClass != StorageClass::Uniform &&
+                storageClass != StorageClass::StorageBuffer)
+            {
+                continue;
+            }
+
+            const uint32_t* set = module.decoration(id, Decoration::DescriptorSet);
+            const uint32_t* binding = module.decoration(id, Decoration::Binding);
+            if (!set || !binding) continue;
+
+            uint32_t count = 1;
+            const uint32_t* resourceType = module.type(typeId);
+            if ((resourceType[0] & 0xffff) == Op::TypeArray)
+            {
+                count = module.arrayLength(resourceType);
+                typeId = resourceType[2];
+            }
+            else if ((resourceType[0] & 0xffff) == Op::TypeRuntimeArray)
+            {
+                count = 0;
+                typeId = resourceType[2];
+            }
+            VkDescriptorType type = module.descriptorType(typeId, storageClass);
+
+            auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const DescriptorBinding& other) {
+                return other.set == *set && other.binding == *binding;
+                });
+            if (existing == bindings.end())
+            {
+                bindings.push_back(DescriptorBinding{ *set, *binding, type, count, static_cast<VkShaderStageFlags>(module.stage) });
+                continue;
+            }
+            if (existing->type != type || existing->count != count)
+            {
+                throw std::runtime_error("set " + std::to_string(*set) + " binding " + std::to_string(*binding) +
+                    " is declared differently by two shader stages!");
+            }
+            existing->stageFlags |= module.stage;
+        }
+
+        std::sort(bindings.begin(), bindings.end(), [](const DescriptorBinding& a, const DescriptorBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+            });
+        std::sort(vertexInputs.begin(), vertexInputs.end(), [](const VertexInput& a, const VertexInput& b) {
+            return a.location < b.location;
+            });
+    }
+
+    VTADescriptorSetLayout::Builder VTAShaderReflection::setLayoutBuilder(VTADevice& device, uint32_t set) const
+    {
+        VTADescriptorSetLayout::Builder builder{ device };
+        for (const DescriptorBinding& binding : bindings)
+        {
+            if (binding.set != set) continue;
+            if (binding.count == 0)
+            {
+                throw std::runtime_error("runtime sized descriptor arrays need a layout with an explicit count!");
+            }
+            builder.addBinding(binding.binding, binding.type, binding.stageFlags, binding.count);
+        }
+        return builder;
+    }
+
+    VkPipelineLayout VTAShaderReflection::acquirePipelineLayout(VTADevice& device, std::span<const VkDescriptorSetLayout> setLayouts) const
+    {
+        if (!bindings.empty() && bindings.back().set >= setLayouts.size())
+        {
+            throw std::runtime_error("pipeline layout is missing a descriptor set the shaders use!");
+        }
+        if (pushConstantRange.offset + pushConstantRange.size > device.properties.limits.maxPushConstantsSize)
+        {
+            throw std::runtime_error("reflected push constants exceed maxPushConstantsSize!");
+        }
+
+        std::span<const VkPushConstantRange> ranges;
+        if (hasPushConstants())
+        {
+            ranges = { &pushConstantRange, 1 };
+        }
+        return device.layoutCache().acquirePipelineLayout(setLayouts, ranges);
+    }
+
+    void VTAShaderReflection::trimVertexInputs(PipelineConfigInfo& configInfo) const
+    {
+        if (!(stages & VK_SHADER_STAGE_VERTEX_BIT)) return;
+
+        auto& attributes = configInfo.attributeDescriptions;
+        attributes.erase(std::remove_if(attributes.begin(), attributes.end(), [this](const VkVertexInputAttributeDescription& attribute) {
+            return std::none_of(vertexInputs.begin(), vertexInputs.end(), [&](const VertexInput& input) {
+                return input.location == attribute.location;
+                });
+            }), attributes.end());
+
+        for (const VertexInput& input : vertexInputs)
+        {
+            bool provided = std::any_of(attributes.begin(), attributes.end(), [&](const VkVertexInputAttributeDescription& attribute) {
+                return attribute.location == input.location;
+                });
+            if (!provided)
+            {
+                throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) + " but no attribute provides it!");
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "VTA_device.hpp"
+#include "VTA_descriptors.h"
+#include "VTA_pipeline.h"
+#include "VTA_shader_library.h"
+
+// std
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace VTA
+{
+    // Reads the interface of one or more SPIR-V stages: descriptor bindings, push constant blocks and vertex inputs.
+    // Stages are merged, so a binding used by the vertex and fragment shader comes back once with both stage flags,
+    // and resources a stage declares but never touches are left out of it. Set layouts and pipeline layouts built from
+    // the result go through the device layout cache like hand written ones, and share handles with them.
+    class VTAShaderReflection
+    {
+        public:
+        struct DescriptorBinding
+        {
+            uint32_t set;
+            uint32_t binding;
+            VkDescriptorType type;
+            uint32_t count;                 // 0 for runtime sized arrays
+            VkShaderStageFlags stageFlags;  // only the stages that access it
+        };
+
+        struct VertexInput
+        {
+            uint32_t location;
+            VkFormat format; // VK_FORMAT_UNDEFINED for types without a 32 bit format
+        };
+
+        VTAShaderReflection() = default;
+        // the shaders are acquired from the library only while they are parsed
+        VTAShaderReflection(VTAShaderLibrary& shaderLibrary, std::initializer_list<std::string> filePaths);
+
+        // throws when the stage declares a binding with a different type than an earlier stage
+        void addStage(const uint32_t* code, size_t codeSize);
+        void addStage(const VTAShaderLibrary::Shader& shader) { addStage(shader.code, shader.codeSize); }
+
+        VkShaderStageFlags getStages() const { return stages; }
+        const std::vector<DescriptorBinding>& getBindings() const { return bindings; } // sorted by set, then binding
+        bool hasPushConstants() const { return pushConstantRange.size > 0; }
+        // one range covering every stage's block, vkCmdPushConstants has to use its stageFlags
+        const VkPushConstantRange& getPushConstantRange() const { return pushConstantRange; }
+        const std::vector<VertexInput>& getVertexInputs() const { return vertexInputs; } // sorted by location
+
+        // a builder holding the bindings of one set, push descriptors or a descriptor buffer can still be added to it
+        VTADescriptorSetLayout::Builder setLayoutBuilder(VTADevice& device, uint32_t set) const;
+        // setLayouts has one layout per set index up to the highest the shaders use, released like any cached layout
+        VkPipelineLayout acquirePipelineLayout(VTADevice& device, std::span<const VkDescriptorSetLayout> setLayouts) const;
+        // drops the attributes the vertex stage never reads, throws when it reads one the config doesn't provide
+        void trimVertexInputs(PipelineConfigInfo& configInfo) const;
+
+        private:
+        VkShaderStageFlags stages = 0;
+        std::vector<DescriptorBinding> bindings;
+        VkPushConstantRange pushConstantRange{};
+        std::vector<VertexInput> vertexInputs;
+    };
+}
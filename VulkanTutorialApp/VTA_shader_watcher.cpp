@@ -0,0 +1,155 @@
+#include "VTA_shader_watcher.h"
+
+// std
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace VTA
+{
+    namespace
+    {
+        constexpr int POLL_INTERVAL_MS = 100; // also how long a burst of saves has to settle before compiling
+    }
+
+    VTAShaderWatcher::VTAShaderWatcher(const std::string& directory, Callback onCompiled, std::string compilerCommand) :
+        directory{ directory }, onCompiled{ std::move(onCompiled) }, compilerCommand{ std::move(compilerCommand) }
+    {
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        // editors either write in place or save to a temporary file and move it over the source
+        if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            std::cerr << "failed to watch shader directory " << directory << ", hot reload is off" << std::endl;
+            if (inotifyFd >= 0)
+            {
+                close(inotifyFd);
+                inotifyFd = -1;
+            }
+            return;
+        }
+#else
+        // the first scan only records the current times
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(this->directory, error))
+        {
+            if (isShaderSource(entry.path()))
+            {
+                writeTimes[entry.path().string()] = entry.last_write_time(error);
+            }
+        }
+#endif
+        thread = std::thread{ &VTAShaderWatcher::watchLoop, this };
+    }
+
+    VTAShaderWatcher::~VTAShaderWatcher()
+    {
+        stopping = true;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+#ifdef __linux__
+        if (inotifyFd >= 0)
+        {
+            close(inotifyFd);
+        }
+#endif
+    }
+
+    bool VTAShaderWatcher::isShaderSource(const std::filesystem::path& path)
+    {
+        static const std::array<std::string, 8> extensions = { ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese", ".task", ".mesh" };
+        std::string extension = path.extension().string();
+        for (const std::string& candidate : extensions)
+        {
+            if (extension == candidate) return true;
+        }
+        return false;
+    }
+
+    void VTAShaderWatcher::watchLoop()
+    {
+        std::set<std::filesystem::path> changed; // one save can raise several events
+        while (!stopping)
+        {
+#ifdef __linux__
+            pollfd descriptor{ inotifyFd, POLLIN, 0 };
+            if (poll(&descriptor, 1, POLL_INTERVAL_MS) > 0)
+            {
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+                {
+                    for (char* position = buffer; position < buffer + length;)
+                    {
+                        auto* event = reinterpret_cast<inotify_event*>(position);
+                        if (event->len > 0 && isShaderSource(event->name))
+                        {
+                            changed.insert(directory / event->name);
+                        }
+                        position += sizeof(inotify_event) + event->len;
+                    }
+                }
+                continue; // keep collecting until the directory is quiet for a whole interval
+            }
+#else
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+            {
+                if (!isShaderSource(entry.path())) continue;
+                auto writeTime = entry.last_write_time(error);
+                auto& known = writeTimes[entry.path().string()];
+                if (known != writeTime)
+                {
+                    known = writeTime;
+                    changed.insert(entry.path());
+                }
+            }
+#endif
+            for (const auto& source : changed)
+            {
+                compile(source);
+            }
+            changed.clear();
+        }
+    }
+
+    void VTAShaderWatcher::compile(const std::filesystem::path& source)
+    {
+        std::filesystem::path output = source;
+        output += ".spv";
+        std::filesystem::path temporary = output;
+        temporary += ".tmp";
+
+        std::string command = compilerCommand + " \"" + source.string() + "\" -o \"" + temporary.string() + "\"";
+        std::error_code error;
+        if (std::system(command.c_str()) != 0)
+        {
+            // the compiler printed the errors, the pipelines keep the last good SPIR-V
+            std::cerr << "failed to compile " << source.string() << ", keeping the old SPIR-V" << std::endl;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        std::filesystem::rename(temporary, output, error);
+        if (error)
+        {
+            std::cerr << "failed to replace " << output.string() << ": " << error.message() << std::endl;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        std::cout << "recompiled " << output.string() << std::endl;
+        onCompiled(output.string());
+    }
+}
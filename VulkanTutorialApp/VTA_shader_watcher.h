@@ -0,0 +1,50 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace VTA
+{
+    // Watches a directory of GLSL sources and recompiles a source to SPIR-V on its own thread whenever it is saved.
+    // The output goes next to the source as <source>.spv, the naming the render systems load. It is written to a
+    // temporary file and renamed over the old one, because the shader library may still have the old file mapped.
+    // onCompiled runs on the watcher thread with the path of every .spv written, typically VTAPipelineCompiler::reload.
+    // Changes are picked up with inotify on Linux and by polling modification times elsewhere.
+    class VTAShaderWatcher
+    {
+        public:
+        using Callback = std::function<void(const std::string& spirvFilePath)>;
+
+        // compilerCommand is called as <compilerCommand> <source> -o <output>, glslc from the Vulkan SDK by default
+        VTAShaderWatcher(const std::string& directory, Callback onCompiled, std::string compilerCommand = "glslc");
+        ~VTAShaderWatcher();
+
+        VTAShaderWatcher(const VTAShaderWatcher&) = delete;
+        VTAShaderWatcher& operator=(const VTAShaderWatcher&) = delete;
+
+        bool isWatching() const { return thread.joinable(); }
+
+        private:
+        static bool isShaderSource(const std::filesystem::path& path);
+
+        void watchLoop();
+        void compile(const std::filesystem::path& source);
+
+        std::filesystem::path directory;
+        Callback onCompiled;
+        std::string compilerCommand;
+
+        std::atomic<bool> stopping{ false };
+#ifdef __linux__
+        int inotifyFd = -1;
+#else
+        std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes; // last seen, watcher thread only
+#endif
+        std::thread thread;
+    };
+}
@@ -29,12 +29,17 @@ VTASwapChain::VTASwapChain(VTADevice& deviceRef, VkExtent2D extent, std::shared_
 }
 
 void VTASwapChain::init() {
+    dynamicRendering = device.dynamicRenderingSupported;
     createSwapChain();
-    createRenderPass();
+    if (!dynamicRendering) {
+      createRenderPass();
+    }
     createImageViews();
     createColorResources();
     createDepthResources();
-    createFramebuffers();
+    if (!dynamicRendering) {
+      createFramebuffers(); // the part a resize has to rebuild, dynamic rendering gets by with the image views
+    }
     createSyncObjects();
 }
 
@@ -59,7 +64,9 @@ VTASwapChain::~VTASwapChain() {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
   }
 
-  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  if (renderPass != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  }
 
   vkDestroyImageView(device.device(), colorImageView, nullptr);
   vkDestroyImage(device.device(), colorImage, nullptr);
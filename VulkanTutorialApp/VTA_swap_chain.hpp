@@ -24,9 +24,17 @@ class VTASwapChain {
   VTASwapChain(const VTASwapChain &) = delete;
   VTASwapChain& operator=(const VTASwapChain &) = delete;
 
+  // with dynamic rendering there is no render pass or framebuffers, the renderer uses the images directly
+  bool usesDynamicRendering() const { return dynamicRendering; }
   VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkRenderPass getRenderPass() { return renderPass; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
+  VkImage getColorImage() { return colorImage; }  // multisampled, resolved into the swap chain image
+  VkImageView getColorImageView() { return colorImageView; }
+  VkImage getDepthImage() { return depthImage; }
+  VkImageView getDepthImageView() { return depthImageView; }
+  VkFormat getDepthFormat() { return swapChaindepthFormat; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -69,8 +77,9 @@ class VTASwapChain {
   VkFormat swapChaindepthFormat;
   VkExtent2D swapChainExtent;
 
+  bool dynamicRendering = false;
   std::vector<VkFramebuffer> swapChainFramebuffers;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
 
   // we need one of these since they will always be written to serially by the gpu
   VkImage colorImage;
@@ -0,0 +1,400 @@
+#include "VTA_texture_atlas.h"
+#include "VTA_image.h"
+#include "VTA_buffer.h"
+#include "VTA_mipgen.h"
+#include "VTA_thread_pool.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace VTA_Image
+{
+	namespace
+	{
+		uint32_t nextPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result < value) result <<= 1;
+			return result;
+		}
+
+		// texel at position index along a Z-order curve, even bits are x and odd bits y
+		void mortonDecode(uint64_t index, uint32_t& x, uint32_t& y)
+		{
+			x = 0;
+			y = 0;
+			for (uint32_t bit = 0; bit < 32; bit++)
+			{
+				x |= static_cast<uint32_t>((index >> (2 * bit)) & 1) << bit;
+				y |= static_cast<uint32_t>((index >> (2 * bit + 1)) & 1) << bit;
+			}
+		}
+	}
+
+	TextureAtlas::TextureAtlas(VTA::VTADevice& device, uint32_t layerSize, VTA::VTAThreadPool* threadPool) :
+		device{ device }, threadPool{ threadPool }, layerSize{ layerSize }
+	{
+		createSampler();
+	}
+
+	TextureAtlas::~TextureAtlas()
+	{
+		for (auto& entry : entries)
+		{
+			if (entry.pixels) stbi_image_free(entry.pixels); // never built
+		}
+
+		vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+		vkDestroySampler(device.device(), sampler, nullptr);
+		vkDestroyImageView(device.device(), imageView, nullptr);
+		vkDestroyImage(device.device(), image, nullptr);
+		vkFreeMemory(device.device(), imageMemory, nullptr);
+	}
+
+	bool TextureAtlas::fits(const char* filepath)
+	{
+		int width, height, channels;
+		if (!stbi_info(filepath, &width, &height, &channels))
+		{
+			throw std::runtime_error("failed to read texture header!");
+		}
+		return static_cast<uint32_t>(width) <= MAX_TEXTURE_SIZE && static_cast<uint32_t>(height) <= MAX_TEXTURE_SIZE;
+	}
+
+	uint32_t TextureAtlas::add(const char* filepath)
+	{
+		assert(!built && "Textures have to be added before the atlas is built");
+
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(filepath, &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+		{
+			throw std::runtime_error("failed to load atlas texture!");
+		}
+		if (static_cast<uint32_t>(width) > MAX_TEXTURE_SIZE || static_cast<uint32_t>(height) > MAX_TEXTURE_SIZE)
+		{
+			stbi_image_free(pixels);
+			throw std::runtime_error("atlas texture is larger than MAX_TEXTURE_SIZE!");
+		}
+
+		entries.push_back({ pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height) });
+		regions.emplace_back();
+		return static_cast<uint32_t>(entries.size() - 1);
+	}
+
+	void TextureAtlas::build()
+	{
+		assert(!built && "An atlas can only be built once");
+		assert(!entries.empty() && "Nothing was added to the atlas");
+
+		pack();
+		upload();
+		createDescriptorSet();
+		built = true;
+	}
+
+	void TextureAtlas::pack()
+	{
+		uint32_t largestBlock = 1;
+		for (auto& entry : entries)
+		{
+			entry.blockSize = nextPowerOfTwo(std::max(entry.width, entry.height));
+			largestBlock = std::max(largestBlock, entry.blockSize);
+		}
+		layerSize = std::max(nextPowerOfTwo(layerSize), largestBlock);
+		if (layerSize > device.properties.limits.maxImageDimension2D)
+		{
+			throw std::runtime_error("atlas layer exceeds maxImageDimension2D!");
+		}
+
+		// largest first, so every block starts on a multiple of its own size along the curve. Such a block covers
+		// a run of the curve and the texels of an aligned square, it has them to itself at every mip level
+		std::vector<uint32_t> order(entries.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return entries[a].blockSize > entries[b].blockSize; });
+
+		uint64_t layerArea = static_cast<uint64_t>(layerSize) * layerSize;
+		uint64_t cursor = 0;
+		layerCount = 1;
+		for (uint32_t index : order)
+		{
+			Entry& entry = entries[index];
+			uint64_t blockArea = static_cast<uint64_t>(entry.blockSize) * entry.blockSize;
+			if (cursor + blockArea > layerArea)
+			{
+				layerCount++;
+				cursor = 0;
+			}
+			entry.layer = layerCount - 1;
+			mortonDecode(cursor, entry.x, entry.y);
+			cursor += blockArea;
+		}
+
+		if (layerCount > device.properties.limits.maxImageArrayLayers)
+		{
+			throw std::runtime_error("atlas needs more layers than maxImageArrayLayers!");
+		}
+
+		mipLevels = static_cast<uint32_t>(std::floor(std::log2(layerSize))) + 1;
+
+		float scale = 1.f / static_cast<float>(layerSize);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const Entry& entry = entries[i];
+			AtlasRegion& region = regions[i];
+			region.layer = entry.layer;
+			region.uvScale = glm::vec2{ entry.width * scale, entry.height * scale };
+			region.uvOffset = glm::vec2{ entry.x * scale, entry.y * scale };
+		}
+	}
+
+	void TextureAtlas::upload()
+	{
+		// staging holds every level of layer 0, then every level of layer 1 and so on
+		std::vector<VkBufferImageCopy> copies;
+		std::vector<VkDeviceSize> levelOffsets; // within one layer
+		VkDeviceSize layerBytes = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			levelOffsets.push_back(layerBytes);
+			uint32_t size = std::max(1u, layerSize >> level);
+			layerBytes += static_cast<VkDeviceSize>(size) * size * 4;
+		}
+
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				uint32_t size = std::max(1u, layerSize >> level);
+				VkBufferImageCopy copy{};
+				copy.bufferOffset = layer * layerBytes + levelOffsets[level];
+				copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				copy.imageSubresource.mipLevel = level;
+				copy.imageSubresource.baseArrayLayer = layer;
+				copy.imageSubresource.layerCount = 1;
+				copy.imageExtent = { size, size, 1 };
+				copies.push_back(copy);
+			}
+		}
+
+		// one layer per instance, the size never goes through 32 bits
+		VkPhysicalDeviceMaintenance3Properties maintenance3{};
+		maintenance3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_3_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &maintenance3;
+		vkGetPhysicalDeviceProperties2(device.physicalDevice, &properties2);
+		VkDeviceSize stagingSize = layerBytes * layerCount;
+		if (stagingSize > maintenance3.maxMemoryAllocationSize)
+		{
+			throw std::runtime_error("atlas staging buffer exceeds maxMemoryAllocationSize!");
+		}
+
+		VTA::VTABuffer stagingBuffer{ device, layerBytes, layerCount,
+										VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+										VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		stagingBuffer.map();
+		auto* staged = static_cast<stbi_uc*>(stagingBuffer.getMappedMemory());
+
+		// unused space stays transparent black
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			std::memset(staged + layer * layerBytes, 0, static_cast<size_t>(layerSize) * layerSize * 4);
+		}
+
+		// entries own disjoint blocks, so they can be copied in on different threads
+		auto copyEntry = [&](uint32_t index)
+		{
+			Entry& entry = entries[index];
+			stbi_uc* layerBase = staged + entry.layer * layerBytes;
+
+			// the texture goes into the block's corner and its edge texels fill the rest, so the block's smaller
+			// levels fade into the edge instead of into black
+			for (uint32_t by = 0; by < entry.blockSize; by++)
+			{
+				uint32_t srcY = std::min(by, entry.height - 1);
+				stbi_uc* dstRow = layerBase + (static_cast<size_t>(entry.y + by) * layerSize + entry.x) * 4;
+				const stbi_uc* srcRow = entry.pixels + static_cast<size_t>(srcY) * entry.width * 4;
+				std::memcpy(dstRow, srcRow, static_cast<size_t>(entry.width) * 4);
+				for (uint32_t bx = entry.width; bx < entry.blockSize; bx++)
+				{
+					std::memcpy(dstRow + bx * 4, srcRow + (entry.width - 1) * 4, 4);
+				}
+			}
+			stbi_image_free(entry.pixels);
+			entry.pixels = nullptr;
+		};
+		if (threadPool != nullptr)
+		{
+			threadPool->parallelFor(static_cast<uint32_t>(entries.size()), copyEntry);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < entries.size(); i++) copyEntry(i);
+		}
+
+		MipGenerator mipGenerator{ threadPool };
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			std::vector<MipLevel> levels;
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				uint32_t size = std::max(1u, layerSize >> level);
+				levels.push_back({ staged + layer * layerBytes + levelOffsets[level], size, size });
+			}
+			mipGenerator.generate(levels, MipFilter::Box, true);
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { layerSize, layerSize, 1 };
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = layerCount;
+		imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+		if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create atlas image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate atlas image memory!");
+		}
+		vkBindImageMemory(device.device(), image, imageMemory, 0);
+
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		imageBarrier(commandBuffer, image, 0, mipLevels,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, layerCount);
+		copyBufferToImage(commandBuffer, stagingBuffer, image, copies);
+		imageBarrier(commandBuffer, image, 0, mipLevels,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, layerCount);
+		device.endSingleTimeCommands(commandBuffer);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = layerCount;
+
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create atlas image view!");
+		}
+	}
+
+	void TextureAtlas::createSampler()
+	{
+		// repeat is done in the shader with fract, the hardware would wrap around the whole layer instead
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.mipLodBias = 0.0f;
+
+		if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create atlas sampler!");
+		}
+	}
+
+	void TextureAtlas::createDescriptorSet()
+	{
+		setLayout = VTA::VTADescriptorSetLayout::Builder(device)
+			.addBinding(TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.build();
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 1; // the atlas never changes after build, every frame shares the set
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create atlas descriptor pool!");
+		}
+
+		VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate atlas descriptor set!");
+		}
+
+		auto imageInfo = descriptorInfo();
+		VTA::VTADescriptorWriter writer{ *setLayout };
+		writer.writeImage(TEXTURE_BINDING, &imageInfo);
+		writer.overwrite(descriptorSet, device);
+	}
+
+	VkDescriptorImageInfo TextureAtlas::descriptorInfo() const
+	{
+		VkDescriptorImageInfo info{};
+		info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.imageView = imageView;
+		info.sampler = sampler;
+		return info;
+	}
+
+	void TextureAtlas::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex)
+	{
+		assert(built && "The atlas has to be built before it is bound");
+		vkCmdBindDescriptorSets(commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			setIndex, 1,
+			&descriptorSet,
+			0,
+			nullptr);
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stb_image.h>
+#include "VTA_device.hpp"
+#include "VTA_descriptors.h"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan expects depth values to be in the range [0, 1]
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace VTA
+{
+	class VTAThreadPool;
+}
+
+namespace VTA_Image
+{
+	// where a texture ended up inside an atlas
+	struct AtlasRegion
+	{
+		uint32_t layer = 0;
+		glm::vec2 uvScale{ 1.f };
+		glm::vec2 uvOffset{ 0.f };
+	};
+
+	// Packs small RGBA8 sRGB textures into the layers of one 2D array image, so they share a single
+	// allocation, view, sampler and descriptor. Every texture gets a layer plus a uv transform into it.
+	// Textures with another format, or larger than MAX_TEXTURE_SIZE, are better off as images of their own.
+	//
+	// Each texture sits in the corner of a power of two block that starts on a multiple of its size, the rest of the
+	// block repeats the texture's edge texels. Down to its 1x1 level a block never shares a texel with another one,
+	// so every texture keeps its full mip chain. The shader clamps the level it samples to that 1x1 level, the
+	// sampler's maxLod is the whole layer's.
+	//
+	// shader side (simple_shader_atlas.frag): layout(set = X, binding = 0) uniform sampler2DArray atlas;
+	//              vec2 atlasUv = fract(uv) * push.uvScale + push.uvOffset;
+	//              textureGrad(atlas, vec3(atlasUv, push.textureLayer), dFdx(uv) * push.uvScale, dFdy(uv) * push.uvScale)
+	// fract keeps repeating uvs inside the texture's own rectangle, the explicit gradients stop it from
+	// picking the smallest mip along the seams fract introduces. atlasUv is clamped half a texel of the sampled
+	// level inside the rectangle, so bilinear taps never reach into the neighbouring block.
+	class TextureAtlas
+	{
+	public:
+		static constexpr uint32_t MAX_TEXTURE_SIZE = 512; // in either dimension
+		static constexpr uint32_t TEXTURE_BINDING = 0;
+
+		// reads only the file's header, whether add() would take it
+		static bool fits(const char* filepath);
+
+		// layerSize grows to fit the largest texture added
+		TextureAtlas(VTA::VTADevice& device, uint32_t layerSize = 2048, VTA::VTAThreadPool* threadPool = nullptr);
+		~TextureAtlas();
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		// decodes the file right away, returns the handle its region is looked up with after build(). Throws for
+		// textures larger than MAX_TEXTURE_SIZE
+		uint32_t add(const char* filepath);
+
+		// packs everything added so far and uploads it in one submission, can only be called once
+		void build();
+
+		const AtlasRegion& getRegion(uint32_t handle) const { return regions[handle]; }
+		uint32_t getLayerCount() const { return layerCount; }
+		uint32_t getLayerSize() const { return layerSize; }
+
+		VkDescriptorImageInfo descriptorInfo() const;
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex);
+
+	private:
+		struct Entry
+		{
+			stbi_uc* pixels;
+			uint32_t width;
+			uint32_t height;
+			// filled in while packing
+			uint32_t blockSize = 0; // width and height rounded up to a square power of two
+			uint32_t layer = 0;
+			uint32_t x = 0;
+			uint32_t y = 0;
+		};
+
+		void pack();
+		void upload();
+		void createSampler();
+		void createDescriptorSet();
+
+		VTA::VTADevice& device;
+		VTA::VTAThreadPool* threadPool;
+
+		uint32_t layerSize;
+		uint32_t layerCount = 0;
+		uint32_t mipLevels = 1;
+		bool built = false;
+
+		std::vector<Entry> entries;
+		std::vector<AtlasRegion> regions;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		std::unique_ptr<VTA::VTADescriptorSetLayout> setLayout;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+}
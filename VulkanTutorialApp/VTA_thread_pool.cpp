@@ -0,0 +1,106 @@
+#include "VTA_thread_pool.h"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace VTA
+{
+	VTAThreadPool::VTAThreadPool(uint32_t threadCount)
+	{
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	VTAThreadPool::~VTAThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t VTAThreadPool::defaultThreadCount()
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	void VTAThreadPool::submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.push(std::move(task));
+		}
+		queueCondition.notify_one();
+	}
+
+	void VTAThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+	{
+		if (count == 0) return;
+		if (count == 1 || workers.empty())
+		{
+			for (uint32_t i = 0; i < count; i++) task(i);
+			return;
+		}
+
+		// helpers may still be looking at the counters after the last index finished, so they share ownership of them
+		struct Batch
+		{
+			std::atomic<uint32_t> next{ 0 };
+			std::atomic<uint32_t> finished{ 0 };
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		auto batch = std::make_shared<Batch>();
+		uint32_t total = count;
+
+		auto runIndices = [batch, total, &task]()
+		{
+			for (uint32_t i = batch->next.fetch_add(1); i < total; i = batch->next.fetch_add(1))
+			{
+				task(i);
+				if (batch->finished.fetch_add(1) + 1 == total)
+				{
+					std::lock_guard<std::mutex> lock(batch->mutex);
+					batch->done.notify_all();
+				}
+			}
+		};
+
+		uint32_t helpers = std::min(count - 1, getThreadCount());
+		for (uint32_t i = 0; i < helpers; i++)
+		{
+			submit(runIndices);
+		}
+		runIndices(); // the calling thread works too instead of just waiting
+
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->done.wait(lock, [&]() { return batch->finished.load() == total; });
+	}
+
+	void VTAThreadPool::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+}
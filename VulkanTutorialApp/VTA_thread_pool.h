@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace VTA
+{
+	// Fixed set of worker threads pulling from one shared queue. Used for CPU side work that can be
+	// split into independent pieces, like generating mip levels on the host.
+	class VTAThreadPool
+	{
+	public:
+		// by default leaves one hardware thread for the main loop
+		explicit VTAThreadPool(uint32_t threadCount = defaultThreadCount());
+		~VTAThreadPool();
+
+		VTAThreadPool(const VTAThreadPool&) = delete;
+		VTAThreadPool& operator=(const VTAThreadPool&) = delete;
+
+		static uint32_t defaultThreadCount();
+
+		void submit(std::function<void()> task);
+
+		// runs task(i) for every i in [0, count) on the workers and the calling thread, returns once all of them are done
+		void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		bool stopping = false;
+	};
+}
@@ -0,0 +1,431 @@
+#include "indirect_render_system.h"
+#include "VTA_parallel_recorder.h"
+#include "VTA_swap_chain.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace VTA
+{
+	static constexpr const char* VERT_SHADER = "indirect_shader.vert.spv";
+	static constexpr const char* FRAG_SHADER = "indirect_shader.frag.spv";
+	static constexpr const char* CULL_SHADER = "indirect_cull.comp.spv";
+	static constexpr uint32_t CULL_GROUP_SIZE = 64; // local_size_x of the cull shader
+
+	namespace
+	{
+		// Gribb and Hartmann, normalised so the distance test works with a radius. Depth is 0..1 like Vulkan's clip space
+		std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& viewProjection)
+		{
+			// glm stores columns, the planes are built from rows
+			auto row = [&](int i) { return glm::vec4{ viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] }; };
+
+			std::array<glm::vec4, 6> planes{
+				row(3) + row(0), // left
+				row(3) - row(0), // right
+				row(3) + row(1), // top
+				row(3) - row(1), // bottom
+				row(2),          // near
+				row(3) - row(2), // far
+			};
+			for (auto& plane : planes)
+			{
+				plane /= glm::length(glm::vec3(plane));
+			}
+			return planes;
+		}
+
+		// same test as indirect_cull.comp
+		bool isSphereVisible(const std::array<glm::vec4, 6>& planes, const glm::mat4& modelMatrix, const glm::vec4& boundingSphere)
+		{
+			glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(boundingSphere), 1.f));
+			float scale = glm::max(glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+				glm::length(glm::vec3(modelMatrix[2])));
+			float radius = boundingSphere.w * scale;
+
+			for (const auto& plane : planes)
+			{
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+			}
+			return true;
+		}
+	}
+
+	IndirectRenderSystem::IndirectRenderSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget,
+		VkDescriptorSetLayout globalSetLayout, VTABindlessTextures& bindlessTextures, uint32_t maxLights) :
+		device{ device }, bindlessTextures{ bindlessTextures }, pipelineCompiler{ pipelineCompiler }
+	{
+		assert(isSupported(device) && "Indirect rendering needs multi draw indirect and bindless textures");
+
+		std::vector<VTADescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 }, // 4 in a cull set, 1 in an object set
+		};
+		descriptorAllocator.init(device.device(), 2 * VTASwapChain::MAX_FRAMES_IN_FLIGHT, sizes);
+
+		VTAShaderReflection reflection{ device.shaderLibrary(), { VERT_SHADER, FRAG_SHADER } };
+		objectSetLayout = reflection.setLayoutBuilder(device, 2).build();
+		createPipelineLayout(reflection, globalSetLayout);
+		createPipeline(renderTarget, maxLights); // queues the pipeline on the compiler, it is not ready when this returns
+		createCullPipeline();
+	}
+
+	IndirectRenderSystem::~IndirectRenderSystem()
+	{
+		pipeline.wait(); // the worker still uses the pipeline layout while it compiles
+		device.layoutCache().releasePipelineLayout(pipelineLayout);
+		device.layoutCache().releasePipelineLayout(cullPipelineLayout);
+		descriptorAllocator.destroy_pools(device.device());
+	}
+
+	void IndirectRenderSystem::createCullPipeline()
+	{
+		VTAShaderReflection reflection{ device.shaderLibrary(), { CULL_SHADER } };
+		if (reflection.getPushConstantRange().size != sizeof(CullPushConstants))
+		{
+			throw std::runtime_error("cull shader push constants don't match CullPushConstants!");
+		}
+
+		cullSetLayout = reflection.setLayoutBuilder(device, 0).build();
+		VkDescriptorSetLayout setLayout = cullSetLayout->getDescriptorSetLayout();
+		cullPipelineLayout = reflection.acquirePipelineLayout(device, { &setLayout, 1 });
+		cullPipeline = std::make_unique<VTAComputePipeline>(device, CULL_SHADER, cullPipelineLayout);
+	}
+
+	void IndirectRenderSystem::createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout)
+	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+			globalSetLayout,
+			bindlessTextures.getDescriptorSetLayout(),
+			objectSetLayout->getDescriptorSetLayout() };
+
+		pipelineLayout = reflection.acquirePipelineLayout(device, descriptorSetLayouts);
+	}
+
+	void IndirectRenderSystem::createPipeline(const RenderTargetInfo& renderTarget, uint32_t maxLights)
+	{
+		assert(pipelineLayout != nullptr && "Pipeline layout must be created before creating the pipeline.");
+
+		VTAShaderReflection reflection{ device.shaderLibrary(), { VERT_SHADER } };
+		PipelineConfigInfo pipelineConfig{};
+		VTAPipeline::defaultPipelineConfigInfo(pipelineConfig, device.msaaSamples);
+		reflection.trimVertexInputs(pipelineConfig);
+		VTAPipeline::setRenderTarget(pipelineConfig, renderTarget);
+		VTAPipeline::useDynamicRenderState(pipelineConfig, device, renderState);
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		assert(maxLights <= MAX_LIGHTS && "The ubo only has room for MAX_LIGHTS lights");
+		pipelineConfig.specialization.set(SpecializationId::MaxLights, maxLights);
+		pipeline = pipelineCompiler.compile(VERT_SHADER, FRAG_SHADER, pipelineConfig);
+	}
+
+	IndirectRenderSystem::ObjectData IndirectRenderSystem::makeObjectData(const VTAGameObject& object, uint32_t mesh)
+	{
+		ObjectData data{};
+		data.modelMatrix = object.transform.mat4();
+		data.normalMatrix = object.transform.normalMatrix();
+		data.mesh = mesh;
+		data.textureIndex = object.model->bindlessTextureIndex;
+		return data;
+	}
+
+	void IndirectRenderSystem::setObjects(const VTAGameObject::Map& gameObjects)
+	{
+		assert(frames.empty() && "setObjects is only called once");
+
+		std::vector<const VTAModel*> models;
+		std::unordered_map<const VTAModel*, uint32_t> meshIndices;
+		for (auto& kv : gameObjects)
+		{
+			const VTAGameObject& object = kv.second;
+			if (object.model == nullptr) continue;
+
+			auto [mesh, inserted] = meshIndices.try_emplace(object.model.get(), static_cast<uint32_t>(models.size()));
+			if (inserted)
+			{
+				models.push_back(object.model.get());
+			}
+			objectIndices[object.getId()] = static_cast<uint32_t>(objects.size());
+			objects.push_back(makeObjectData(object, mesh->second));
+		}
+
+		if (objects.empty()) return;
+		if (objects.size() > device.properties.limits.maxDrawIndirectCount)
+		{
+			throw std::runtime_error("failed to set up indirect rendering, more objects than maxDrawIndirectCount!");
+		}
+
+		packMeshes(models);
+		createFrameResources();
+	}
+
+	void IndirectRenderSystem::packMeshes(const std::vector<const VTAModel*>& models)
+	{
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		std::vector<uint32_t> generatedIndices; // models without an index buffer draw their vertices in order
+		std::vector<uint32_t> generatedOffsets(models.size());
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			const VTAModel& model = *models[i];
+			MeshData mesh{};
+			mesh.indexCount = model.getIndexBuffer() != VK_NULL_HANDLE ? model.getIndexCount() : model.getVertexCount();
+			mesh.firstIndex = indexCount;
+			mesh.vertexOffset = static_cast<int32_t>(vertexCount);
+			mesh.boundingSphere = model.getBoundingSphere();
+			meshes.push_back(mesh);
+
+			if (model.getIndexBuffer() == VK_NULL_HANDLE)
+			{
+				generatedOffsets[i] = static_cast<uint32_t>(generatedIndices.size());
+				for (uint32_t index = 0; index < model.getVertexCount(); index++)
+				{
+					generatedIndices.push_back(index);
+				}
+			}
+			vertexCount += model.getVertexCount();
+			indexCount += mesh.indexCount;
+		}
+
+		vertexBuffer = std::make_unique<VTABuffer>(device, sizeof(VTAModel::Vertex), vertexCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		indexBuffer = std::make_unique<VTABuffer>(device, sizeof(uint32_t), indexCount,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		std::unique_ptr<VTABuffer> generatedStaging;
+		if (!generatedIndices.empty())
+		{
+			generatedStaging = std::make_unique<VTABuffer>(device, sizeof(uint32_t), static_cast<uint32_t>(generatedIndices.size()),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			generatedStaging->map();
+			generatedStaging->writeToBuffer(generatedIndices.data());
+		}
+
+		// the models' buffers are already on the device, they are copied over without going through the host
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			const VTAModel& model = *models[i];
+			const MeshData& mesh = meshes[i];
+
+			VkBufferCopy vertexCopy{};
+			vertexCopy.dstOffset = static_cast<VkDeviceSize>(mesh.vertexOffset) * sizeof(VTAModel::Vertex);
+			vertexCopy.size = static_cast<VkDeviceSize>(model.getVertexCount()) * sizeof(VTAModel::Vertex);
+			vkCmdCopyBuffer(commandBuffer, model.getVertexBuffer(), vertexBuffer->getBuffer(), 1, &vertexCopy);
+
+			VkBufferCopy indexCopy{};
+			indexCopy.dstOffset = static_cast<VkDeviceSize>(mesh.firstIndex) * sizeof(uint32_t);
+			indexCopy.size = static_cast<VkDeviceSize>(mesh.indexCount) * sizeof(uint32_t);
+			if (model.getIndexBuffer() != VK_NULL_HANDLE)
+			{
+				vkCmdCopyBuffer(commandBuffer, model.getIndexBuffer(), indexBuffer->getBuffer(), 1, &indexCopy);
+			}
+			else
+			{
+				indexCopy.srcOffset = static_cast<VkDeviceSize>(generatedOffsets[i]) * sizeof(uint32_t);
+				vkCmdCopyBuffer(commandBuffer, generatedStaging->getBuffer(), indexBuffer->getBuffer(), 1, &indexCopy);
+			}
+		}
+		device.endSingleTimeCommands(commandBuffer);
+
+		VTABuffer stagingBuffer{ device, sizeof(MeshData), static_cast<uint32_t>(meshes.size()),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		stagingBuffer.map();
+		stagingBuffer.writeToBuffer(meshes.data());
+
+		meshBuffer = std::make_unique<VTABuffer>(device, sizeof(MeshData), static_cast<uint32_t>(meshes.size()),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		device.copyBuffer(stagingBuffer.getBuffer(), meshBuffer->getBuffer(), stagingBuffer.getBufferSize());
+	}
+
+	void IndirectRenderSystem::createFrameResources()
+	{
+		uint32_t objectCount = static_cast<uint32_t>(objects.size());
+
+		frames.resize(VTASwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames)
+		{
+			frame.objectBuffer = std::make_unique<VTABuffer>(device, sizeof(ObjectData), objectCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.objectBuffer->map();
+			frame.objectBuffer->writeToBuffer(objects.data());
+			frame.objectBuffer->flush();
+
+			frame.drawBuffer = std::make_unique<VTABuffer>(device, sizeof(VkDrawIndexedIndirectCommand), objectCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			frame.countBuffer = std::make_unique<VTABuffer>(device, sizeof(uint32_t), 1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			VkDescriptorBufferInfo objectInfo = frame.objectBuffer->descriptorInfo();
+			VkDescriptorBufferInfo meshInfo = meshBuffer->descriptorInfo();
+			VkDescriptorBufferInfo drawInfo = frame.drawBuffer->descriptorInfo();
+			VkDescriptorBufferInfo countInfo = frame.countBuffer->descriptorInfo();
+
+			// the buffers never change, neither do the sets
+			frame.cullSet = descriptorAllocator.allocate(device.device(), cullSetLayout->getDescriptorSetLayout());
+			VTADescriptorWriter{ *cullSetLayout }
+				.writeBuffer(0, &objectInfo)
+				.writeBuffer(1, &meshInfo)
+				.writeBuffer(2, &drawInfo)
+				.writeBuffer(3, &countInfo)
+				.overwrite(frame.cullSet, device);
+
+			frame.objectSet = descriptorAllocator.allocate(device.device(), objectSetLayout->getDescriptorSetLayout());
+			VTADescriptorWriter{ *objectSetLayout }
+				.writeBuffer(0, &objectInfo)
+				.overwrite(frame.objectSet, device);
+		}
+	}
+
+	void IndirectRenderSystem::updateObject(const VTAGameObject& object)
+	{
+		auto found = objectIndices.find(object.getId());
+		if (found == objectIndices.end()) return;
+
+		uint32_t index = found->second;
+		objects[index] = makeObjectData(object, objects[index].mesh); // a model change needs setObjects
+		for (auto& frame : frames)
+		{
+			frame.pendingUpdates.push_back(index);
+		}
+	}
+
+	void IndirectRenderSystem::resetDrawCount(FrameInfo& frameInfo)
+	{
+		if (objects.empty() || !device.drawIndirectCountSupported) return;
+		vkCmdFillBuffer(frameInfo.commandBuffer, frames[frameInfo.frameIndex].countBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+	}
+
+	void IndirectRenderSystem::cull(FrameInfo& frameInfo)
+	{
+		if (objects.empty()) return;
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		// beginFrame waited on this frame's fence, nothing reads its object buffer any more
+		if (!frame.pendingUpdates.empty())
+		{
+			for (uint32_t index : frame.pendingUpdates)
+			{
+				frame.objectBuffer->writeToBuffer(&objects[index], sizeof(ObjectData), index * sizeof(ObjectData));
+			}
+			frame.objectBuffer->flush();
+			frame.pendingUpdates.clear();
+		}
+
+		CullPushConstants push{};
+		auto planes = frustumPlanes(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+		std::copy(planes.begin(), planes.end(), push.frustumPlanes);
+		push.objectCount = static_cast<uint32_t>(objects.size());
+		push.compact = device.drawIndirectCountSupported ? 1 : 0;
+
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+		vkCmdDispatch(commandBuffer, (push.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	VkBuffer IndirectRenderSystem::getDrawBuffer(int frameIndex) const
+	{
+		return objects.empty() ? VK_NULL_HANDLE : frames[frameIndex].drawBuffer->getBuffer();
+	}
+
+	VkBuffer IndirectRenderSystem::getCountBuffer(int frameIndex) const
+	{
+		return objects.empty() || !device.drawIndirectCountSupported ? VK_NULL_HANDLE : frames[frameIndex].countBuffer->getBuffer();
+	}
+
+	void IndirectRenderSystem::render(FrameInfo& frameInfo)
+	{
+		if (objects.empty()) return;
+
+		if (frameInfo.parallelRecorder)
+		{
+			// one draw, so one secondary
+			frameInfo.parallelRecorder->record(frameInfo.commandBuffer, 1,
+				[&](VkCommandBuffer commandBuffer, uint32_t, uint32_t) { recordDraws(commandBuffer, frameInfo); });
+			return;
+		}
+		recordDraws(frameInfo.commandBuffer, frameInfo);
+	}
+
+	void IndirectRenderSystem::recordDraws(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo)
+	{
+		if (!pipeline.bind(commandBuffer)) return; // still compiling, nothing to draw with yet
+		VTAPipeline::setDynamicRenderState(commandBuffer, device, renderState);
+
+		const FrameResources& frame = frames[frameInfo.frameIndex];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.descriptorSets[0], 0, nullptr);
+		bindlessTextures.bind(commandBuffer, pipelineLayout, 1);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &frame.objectSet, 0, nullptr);
+
+		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		uint32_t objectCount = static_cast<uint32_t>(objects.size());
+		uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		if (device.drawIndirectCountSupported)
+		{
+			device.cmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer->getBuffer(), 0,
+				frame.countBuffer->getBuffer(), 0, objectCount, stride);
+		}
+		else
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer->getBuffer(), 0, objectCount, stride);
+		}
+	}
+
+	std::vector<VkDrawIndexedIndirectCommand> IndirectRenderSystem::cullOnCpu(const glm::mat4& viewProjection) const
+	{
+		auto planes = frustumPlanes(viewProjection);
+
+		std::vector<VkDrawIndexedIndirectCommand> draws;
+		for (uint32_t i = 0; i < objects.size(); i++)
+		{
+			const MeshData& mesh = meshes[objects[i].mesh];
+			if (!isSphereVisible(planes, objects[i].modelMatrix, mesh.boundingSphere)) continue;
+			draws.push_back(VkDrawIndexedIndirectCommand{ mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, i });
+		}
+		return draws;
+	}
+
+	std::vector<VkDrawIndexedIndirectCommand> IndirectRenderSystem::readBackDraws(int frameIndex)
+	{
+		if (objects.empty()) return {};
+		const FrameResources& frame = frames[frameIndex];
+
+		VTABuffer drawStaging{ device, sizeof(VkDrawIndexedIndirectCommand), static_cast<uint32_t>(objects.size()),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		VTABuffer countStaging{ device, sizeof(uint32_t), 1,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+		device.copyBuffer(frame.drawBuffer->getBuffer(), drawStaging.getBuffer(), drawStaging.getBufferSize());
+		device.copyBuffer(frame.countBuffer->getBuffer(), countStaging.getBuffer(), countStaging.getBufferSize());
+		drawStaging.map();
+		countStaging.map();
+
+		auto* written = static_cast<const VkDrawIndexedIndirectCommand*>(drawStaging.getMappedMemory());
+		uint32_t count = device.drawIndirectCountSupported ?
+			*static_cast<const uint32_t*>(countStaging.getMappedMemory()) : static_cast<uint32_t>(objects.size());
+		if (count > objects.size())
+		{
+			// the draw buffer only has a slot per object, a count past that is the cull's bug to report, not to read
+			std::cout << "gpu cull counted " << count << " draws for " << objects.size() << " objects\n";
+			count = static_cast<uint32_t>(objects.size());
+		}
+
+		// compacted draws come in whatever order the invocations got their slots
+		std::vector<VkDrawIndexedIndirectCommand> draws;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (written[i].instanceCount > 0) draws.push_back(written[i]);
+		}
+		std::sort(draws.begin(), draws.end(), [](const VkDrawIndexedIndirectCommand& a, const VkDrawIndexedIndirectCommand& b) {
+			return a.firstInstance < b.firstInstance;
+			});
+		return draws;
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+
+#include "VTA_pipeline.h"
+#include "VTA_pipeline_compiler.h"
+#include "VTA_device.hpp"
+#include "VTA_model.h"
+#include "VTA_game_object.h"
+#include "VTA_frame_info.h"
+#include "VTA_bindless.h"
+#include "VTA_buffer.h"
+#include "VTA_descriptors.h"
+#include "VTA_shader_reflection.h"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace VTA
+{
+	// GPU driven counterpart of SimpleRenderSystem. Every model is packed into one shared vertex and index buffer,
+	// objects live in a storage buffer, and each frame a compute pass (indirect_cull.comp) frustum culls them and
+	// writes the draw commands that a single vkCmdDrawIndexedIndirectCount then draws. Without VK_KHR_draw_indirect_count
+	// culled objects keep their slot with instanceCount 0 and the draw is a plain multi draw over all of them.
+	// Per frame the host only records the dispatch and the draw and writes the objects that changed, so its cost
+	// doesn't grow with the object count. Textures come from the bindless array.
+	class IndirectRenderSystem
+	{
+	public:
+		// maxLights is baked into the fragment shader's light loop, like SimpleRenderSystem::ShaderVariant::maxLights
+		IndirectRenderSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget,
+			VkDescriptorSetLayout globalSetLayout, VTABindlessTextures& bindlessTextures, uint32_t maxLights = MAX_LIGHTS);
+		~IndirectRenderSystem();
+
+		IndirectRenderSystem(const IndirectRenderSystem&) = delete;
+		IndirectRenderSystem& operator=(const IndirectRenderSystem&) = delete; // this is to establish unique ownership of resources
+
+		// firstInstance carries the object index, and a draw count above one needs multiDrawIndirect
+		static bool isSupported(const VTADevice& device)
+		{
+			return device.multiDrawIndirectSupported && VTABindlessTextures::isSupported(device);
+		}
+
+		// once, before the first frame. Uploads every object that has a model and packs the models it uses
+		void setObjects(const VTAGameObject::Map& gameObjects);
+		// objects are static after setObjects, nothing in this app moves one that has a model. Whoever changes a transform
+		// or texture calls this, and the change reaches each frame's copy of the object when that frame is culled next
+		void updateObject(const VTAGameObject& object);
+
+		// outside the render pass, in this order and each in a frame graph pass of its own. The graph puts the barriers
+		// between them from what the passes declare:
+		// resetDrawCount writes the count buffer as a transfer destination, it does nothing without a count buffer
+		void resetDrawCount(FrameInfo& frameInfo);
+		// cull writes the draw buffer and the count buffer as compute storage
+		void cull(FrameInfo& frameInfo);
+		// inside the render pass, reads the draw buffer and the count buffer as indirect commands
+		void render(FrameInfo& frameInfo);
+
+		// the frame's buffers for the declarations above. Null while there are no objects, the count buffer also
+		// without VK_KHR_draw_indirect_count
+		VkBuffer getDrawBuffer(int frameIndex) const;
+		VkBuffer getCountBuffer(int frameIndex) const;
+
+		// the draws the GPU would write for viewProjection, in object order. Objects within rounding of a plane can
+		// come out differently on the GPU, everything else matches readBackDraws
+		std::vector<VkDrawIndexedIndirectCommand> cullOnCpu(const glm::mat4& viewProjection) const;
+		// what the last cull of frameIndex wrote, in object order. The caller has waited for that frame to finish
+		std::vector<VkDrawIndexedIndirectCommand> readBackDraws(int frameIndex);
+
+		uint32_t getObjectCount() const { return static_cast<uint32_t>(objects.size()); }
+
+	private:
+		// std430 layouts of indirect_cull.comp and indirect_shader.vert
+		struct ObjectData
+		{
+			glm::mat4 modelMatrix{ 1.f };
+			glm::mat4 normalMatrix{ 1.f };
+			uint32_t mesh = 0;
+			uint32_t textureIndex = 0;
+			uint32_t pad[2]{};
+		};
+
+		struct MeshData
+		{
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t pad;
+			glm::vec4 boundingSphere;
+		};
+
+		struct CullPushConstants
+		{
+			glm::vec4 frustumPlanes[6];
+			uint32_t objectCount;
+			uint32_t compact;
+		};
+
+		void createCullPipeline();
+		void createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout);
+		void createPipeline(const RenderTargetInfo& renderTarget, uint32_t maxLights);
+		void packMeshes(const std::vector<const VTAModel*>& models);
+		void createFrameResources();
+		// binds everything itself so it works in a fresh secondary
+		void recordDraws(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo);
+
+		static ObjectData makeObjectData(const VTAGameObject& object, uint32_t mesh);
+
+		VTADevice& device;
+		VTABindlessTextures& bindlessTextures;
+
+		VTAPipelineCompiler& pipelineCompiler;
+		VTAPipelineCompiler::Handle pipeline; // draws are skipped until the compiler has something to bind
+		DynamicRenderState renderState; // set after every bind, the pipeline only holds it where the device can't
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<VTADescriptorSetLayout> objectSetLayout; // set 2 of the draw
+
+		std::unique_ptr<VTADescriptorSetLayout> cullSetLayout;
+		VkPipelineLayout cullPipelineLayout;
+		std::unique_ptr<VTAComputePipeline> cullPipeline;
+		VTADescriptorAllocatorGrowable descriptorAllocator;
+
+		// shared by every object
+		std::unique_ptr<VTABuffer> vertexBuffer;
+		std::unique_ptr<VTABuffer> indexBuffer;
+		std::unique_ptr<VTABuffer> meshBuffer;
+		std::vector<MeshData> meshes;
+
+		// the host copy every frame's object buffer is written from
+		std::vector<ObjectData> objects;
+		std::unordered_map<VTAGameObject::id_t, uint32_t> objectIndices;
+
+		// one of each per frame in flight, a frame's objects can change while an earlier one still draws
+		struct FrameResources
+		{
+			std::unique_ptr<VTABuffer> objectBuffer; // host visible, persistently mapped
+			std::unique_ptr<VTABuffer> drawBuffer;
+			std::unique_ptr<VTABuffer> countBuffer;
+			VkDescriptorSet cullSet = VK_NULL_HANDLE;
+			VkDescriptorSet objectSet = VK_NULL_HANDLE;
+			std::vector<uint32_t> pendingUpdates; // objects changed since this frame last culled
+		};
+		std::vector<FrameResources> frames;
+	};
+}
@@ -0,0 +1,83 @@
+#version 450
+// Blinn-Phong with the texture taken from the bindless array, by the index the vertex shader passes on.
+//
+// glslc indirect_shader.frag -o indirect_shader.frag.spv
+
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragUv;
+layout(location = 4) flat in uint fragTextureIndex;
+
+layout(location = 0) out vec4 outColor;
+
+struct PointLight
+{
+	vec4 position; // ignore w
+	vec4 color;    // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	PointLight pointLights[100];
+	int numLights;
+} ubo;
+
+// SpecializationId in VTA_frame_info.h, IndirectRenderSystem only sets MAX_LIGHTS
+layout(constant_id = 0) const uint MAX_LIGHTS = 100; // the loop's bound, so the driver can unroll it
+layout(constant_id = 1) const bool TEXTURE_SAMPLING = true;
+layout(constant_id = 2) const uint LIGHTING_MODEL = 0; // LightingModel: 0 Blinn-Phong, 1 Lambert, 2 unlit
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+void main()
+{
+	vec3 textureColor = vec3(1.0);
+	if (TEXTURE_SAMPLING)
+	{
+		// draws of one multi draw can pick different textures
+		textureColor = texture(textures[nonuniformEXT(fragTextureIndex)], fragUv).rgb;
+	}
+
+	if (LIGHTING_MODEL == 2u)
+	{
+		outColor = vec4(textureColor * fragColor, 1.0);
+		return;
+	}
+
+	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 specularLight = vec3(0.0);
+	vec3 surfaceNormal = normalize(fragNormalWorld);
+
+	vec3 cameraPosWorld = ubo.invView[3].xyz;
+	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+	for (uint i = 0u; i < MAX_LIGHTS; i++)
+	{
+		if (i >= uint(ubo.numLights)) break;
+
+		PointLight light = ubo.pointLights[i];
+		vec3 directionToLight = light.position.xyz - fragPosWorld;
+		float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
+		directionToLight = normalize(directionToLight);
+
+		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
+		vec3 intensity = light.color.xyz * light.color.w * attenuation;
+		diffuseLight += intensity * cosAngIncidence;
+
+		if (LIGHTING_MODEL == 0u)
+		{
+			vec3 halfAngle = normalize(directionToLight + viewDirection);
+			float blinnTerm = pow(clamp(dot(surfaceNormal, halfAngle), 0, 1), 512.0);
+			specularLight += intensity * blinnTerm;
+		}
+	}
+
+	outColor = vec4((diffuseLight + specularLight) * textureColor * fragColor, 1.0);
+}
@@ -0,0 +1,58 @@
+#version 450
+// Vertex shader of IndirectRenderSystem. Objects come from a storage buffer instead of push constants,
+// the cull shader puts each draw's object index in firstInstance and it arrives here as gl_InstanceIndex.
+//
+// glslc indirect_shader.vert -o indirect_shader.vert.spv
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) flat out uint fragTextureIndex;
+
+struct PointLight
+{
+	vec4 position; // ignore w
+	vec4 color;    // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	PointLight pointLights[100];
+	int numLights;
+} ubo;
+
+struct ObjectData
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	uint mesh;
+	uint textureIndex;
+	uint pad0;
+	uint pad1;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects { ObjectData objects[]; };
+
+void main()
+{
+	ObjectData object = objects[gl_InstanceIndex];
+
+	vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+
+	fragNormalWorld = normalize(mat3(object.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	fragColor = color;
+	fragUv = uv;
+	fragTextureIndex = object.textureIndex;
+}
@@ -1,4 +1,5 @@
 #include "point_light_system.h"
+#include "VTA_parallel_recorder.h"
 #include <stdexcept>
 #include <array>
 
@@ -19,49 +20,45 @@ namespace VTA
 
 	};
 
+	static constexpr const char* VERT_SHADER = "point_light.vert.spv";
+	static constexpr const char* FRAG_SHADER = "point_light.frag.spv";
 
-	PointLightSystem::PointLightSystem(VTADevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device{ device }
+
+	PointLightSystem::PointLightSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget, VkDescriptorSetLayout globalSetLayout) : device{ device }, pipelineCompiler{ pipelineCompiler }
 	{
-		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass); // create the pipeline with the shader modules and pipeline layout
+		VTAShaderReflection reflection{ device.shaderLibrary(), { VERT_SHADER, FRAG_SHADER } };
+		if (reflection.getPushConstantRange().size > sizeof(PointLightPushConstants))
+		{
+			throw std::runtime_error("shader push constants are larger than PointLightPushConstants!");
+		}
+		pushConstantSize = reflection.getPushConstantRange().size;
+		pushConstantStages = reflection.getPushConstantRange().stageFlags;
+
+		createPipelineLayout(reflection, globalSetLayout);
+		createPipeline(renderTarget); // queues the pipeline on the compiler, it is not ready when this returns
 	}
 
 	PointLightSystem::~PointLightSystem()
 	{
-		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+		pipeline.wait(); // the worker still uses the pipeline layout while it compiles
+		device.layoutCache().releasePipelineLayout(pipelineLayout);
 	}
 
 
 
-	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void PointLightSystem::createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout)
 	{
-
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // which shader stages can access the push constant
-		pushConstantRange.offset = 0; // offset in bytes from the start of the push constant range
-		pushConstantRange.size = sizeof(PointLightPushConstants); // size of the push constant in bytes 
-
-
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()); // Optional
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data(); // info sent to the pipieline other than vertex info
-		pipelineLayoutInfo.pushConstantRangeCount = 1; // Very efficient way to send data to shader programs
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// push constants come from the shaders, render systems with the same interface end up with the same layout
+		pipelineLayout = reflection.acquirePipelineLayout(device, descriptorSetLayouts);
 	}
 
 
 
 
 
-	void PointLightSystem::createPipeline(VkRenderPass renderPass)
+	void PointLightSystem::createPipeline(const RenderTargetInfo& renderTarget)
 	{
 
 		assert(pipelineLayout != nullptr && "Pipeline layout must be created before creating the pipeline.");
@@ -69,13 +66,14 @@ namespace VTA
 
 		PipelineConfigInfo pipelineConfig{};
 		VTAPipeline::defaultPipelineConfigInfo(pipelineConfig, device.msaaSamples);
-		VTAPipeline::enableAlphaBlending(pipelineConfig); // enable alpha blending for the point light system
+		renderState.blendEnable = true; // enable alpha blending for the point light system
+		VTAPipeline::useDynamicRenderState(pipelineConfig, device, renderState);
 		pipelineConfig.bindingDescription.clear();
 		pipelineConfig.attributeDescriptions.clear();
 
-		pipelineConfig.renderPass = renderPass;
+		VTAPipeline::setRenderTarget(pipelineConfig, renderTarget);
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		pipeline = std::make_unique<VTAPipeline>(device, "point_light.vert.spv", "point_light.frag.spv", pipelineConfig);
+		pipeline = pipelineCompiler.compile(VERT_SHADER, FRAG_SHADER, pipelineConfig);
 	}
 
 
@@ -96,10 +94,32 @@ namespace VTA
 
 
 
-		pipeline->bind(frameInfo.commandBuffer); // bind the pipeline to the command buffer
+		// back to front, the blending depends on it
+		std::vector<const VTAGameObject*> lights;
+		lights.reserve(sorted.size());
+		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+		{
+			lights.push_back(&frameInfo.gameObjects.at(it->second));
+		}
+
+		if (frameInfo.parallelRecorder)
+		{
+			// ranges are executed in order, so the back to front order survives the split
+			frameInfo.parallelRecorder->record(frameInfo.commandBuffer, static_cast<uint32_t>(lights.size()),
+				[&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) { recordLights(commandBuffer, frameInfo, lights, begin, end); });
+			return;
+		}
+		recordLights(frameInfo.commandBuffer, frameInfo, lights, 0, static_cast<uint32_t>(lights.size()));
+	}
+
+	void PointLightSystem::recordLights(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, const std::vector<const VTAGameObject*>& lights,
+		uint32_t begin, uint32_t end)
+	{
+		if (!pipeline.bind(commandBuffer)) return; // still compiling, nothing to draw with yet
+		VTAPipeline::setDynamicRenderState(commandBuffer, device, renderState);
 
 		vkCmdBindDescriptorSets
-		(frameInfo.commandBuffer,
+		(commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
 			0, 1,
@@ -107,10 +127,9 @@ namespace VTA
 			0,
 			nullptr);
 
-		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+		for (uint32_t i = begin; i < end; i++)
 		{
-			auto& obj = frameInfo.gameObjects.at(it->second);
-			if (obj.pointLight == nullptr) continue;
+			auto& obj = *lights[i];
 
 			PointLightPushConstants push{};
 			push.position = glm::vec4(obj.transform.translation, 1.f);
@@ -118,11 +137,11 @@ namespace VTA
 			push.radius = obj.transform.scale.x;
 
 			vkCmdPushConstants(
-				frameInfo.commandBuffer,
+				commandBuffer,
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0, sizeof(PointLightPushConstants), &push); // push the constants to the shader
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0); // draw the point light as a quad
+				pushConstantStages,
+				0, pushConstantSize, &push); // push the constants to the shader
+			vkCmdDraw(commandBuffer, 6, 1, 0, 0); // draw the point light as a quad
 		}
 
 		
@@ -136,6 +155,7 @@ namespace VTA
 		{
 			auto& obj = kv.second;
 			if (obj.pointLight == nullptr) continue;
+			assert(lightIndex < MAX_LIGHTS && "More point lights than the ubo has room for");
 
 			ubo.pointLightS[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
 			ubo.pointLightS[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
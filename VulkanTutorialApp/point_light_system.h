@@ -2,11 +2,13 @@
 
 
 #include "VTA_pipeline.h"
+#include "VTA_pipeline_compiler.h"
 #include "VTA_device.hpp"
 #include "VTA_model.h"
 #include "VTA_game_object.h"
 #include "VTA_camera.h"
 #include "VTA_frame_info.h"
+#include "VTA_shader_reflection.h"
 
 #include <map>
 #include <memory>
@@ -19,7 +21,7 @@ namespace VTA
 	public:
 
 
-		PointLightSystem(VTADevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		PointLightSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget, VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
 		PointLightSystem(const PointLightSystem&) = delete;
@@ -30,15 +32,22 @@ namespace VTA
 
 	private:
 
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout);
+		void createPipeline(const RenderTargetInfo& renderTarget);
+		// draws lights[begin, end), binds everything itself so it works in a fresh secondary
+		void recordLights(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, const std::vector<const VTAGameObject*>& lights,
+			uint32_t begin, uint32_t end);
 
 
 		
 
 		VTADevice& device;
 
-		std::unique_ptr<VTAPipeline> pipeline;
+		VTAPipelineCompiler& pipelineCompiler;
+		VTAPipelineCompiler::Handle pipeline; // draws are skipped until the compiler has something to bind
+		DynamicRenderState renderState; // set after every bind, the pipeline only holds it where the device can't
 		VkPipelineLayout pipelineLayout;
+		uint32_t pushConstantSize;
+		VkShaderStageFlags pushConstantStages; // the stages whose shaders declare the block
 	};
 }
\ No newline at end of file
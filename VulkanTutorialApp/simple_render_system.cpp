@@ -1,4 +1,6 @@
 #include "simple_render_system.h"
+#include "VTA_parallel_recorder.h"
+#include "VTA_swap_chain.hpp"
 #include <stdexcept>
 #include <array>
 
@@ -10,56 +12,90 @@
 
 namespace VTA
 {
+	// the matrices come from the instance buffer, only the draw's texture is pushed. Only the bindless and atlas
+	// shaders declare the block, the classic ones bind their texture instead
 	struct SimplePushConstantsData
+	{
+		uint32_t textureIndex{ 0 };
+		uint32_t textureLayer{ 0 };
+		glm::vec2 uvScale{ 1.f };
+		glm::vec2 uvOffset{ 0.f };
+	};
+	static_assert(sizeof(SimplePushConstantsData) <= 128, "Every device has at least 128 bytes of push constants");
+
+	// std430 layout of simple_shader_instanced.vert
+	struct InstanceData
 	{
 		glm::mat4 modelMatrix{ 1.f };
-		//alignas(16) glm::vec3 color;
 		glm::mat4 normalMatrix{ 1.f };
 	};
 
+	static constexpr const char* VERT_SHADER = "simple_shader_instanced.vert.spv";
+
 
-	SimpleRenderSystem::SimpleRenderSystem(VTADevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout) : device{ device }
+	SimpleRenderSystem::SimpleRenderSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget, VkDescriptorSetLayout globalSetLayout,
+		VTABindlessTextures* bindlessTextures, VTA_Image::TextureAtlas* textureAtlas, const ShaderVariant& variant, VTAThreadPool* threadPool) : device{ device }, bindlessTextures{ bindlessTextures }, textureAtlas{ textureAtlas },
+		drawList{ threadPool }, pipelineCompiler{ pipelineCompiler }
 	{
-		createPipelineLayout(globalSetLayout, textureSetLayout);
-		createPipeline(renderPass); // create the pipeline with the shader modules and pipeline layout
+		assert(!(bindlessTextures && textureAtlas) && "Bindless and atlas texturing are separate modes");
+
+		const char* fragShader = "simple_shader.frag.spv";
+		if (bindlessTextures) fragShader = "simple_shader_bindless.frag.spv";
+		if (textureAtlas) fragShader = "simple_shader_atlas.frag.spv";
+		VTAShaderReflection reflection{ device.shaderLibrary(), { VERT_SHADER, fragShader } };
+
+		const VkPushConstantRange& pushConstantRange = reflection.getPushConstantRange();
+		assert(pushConstantRange.offset == 0 && "The push constant block starts at the texture index");
+		if (pushConstantRange.size > sizeof(SimplePushConstantsData))
+		{
+			throw std::runtime_error("shader push constants are larger than SimplePushConstantsData!");
+		}
+		pushConstantSize = pushConstantRange.size;
+		pushConstantStages = pushConstantRange.stageFlags;
+
+		VkDescriptorSetLayout textureSetLayout;
+		if (bindlessTextures)
+		{
+			textureSetLayout = bindlessTextures->getDescriptorSetLayout();
+		}
+		else if (textureAtlas)
+		{
+			textureSetLayout = textureAtlas->getDescriptorSetLayout();
+		}
+		else
+		{
+			perDrawTextureLayout = reflection.setLayoutBuilder(device, 1)
+				.usePushDescriptors()
+				.build();
+			textureSetLayout = perDrawTextureLayout->getDescriptorSetLayout();
+		}
+		instanceSetLayout = reflection.setLayoutBuilder(device, 2).build();
+		instanceBuffers.resize(VTASwapChain::MAX_FRAMES_IN_FLIGHT);
+		createPipelineLayout(reflection, globalSetLayout, textureSetLayout);
+		createPipeline(reflection, fragShader, renderTarget, variant); // queues the pipeline on the compiler, it is not ready when this returns
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem()
 	{
-		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+		pipeline.wait(); // the worker still uses the pipeline layout while it compiles
+		device.layoutCache().releasePipelineLayout(pipelineLayout);
 	}
 
 
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout)
+	void SimpleRenderSystem::createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout)
 	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts { globalSetLayout, textureSetLayout, instanceSetLayout->getDescriptorSetLayout() };
 
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // which shader stages can access the push constant
-		pushConstantRange.offset = 0; // offset in bytes from the start of the push constant range
-		pushConstantRange.size = sizeof(SimplePushConstantsData); // size of the push constant in bytes
-
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts { globalSetLayout, textureSetLayout };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()); // Optional
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data(); // info sent to the pipieline other than vertex info
-		pipelineLayoutInfo.pushConstantRangeCount = 1; // Very efficient way to send data to shader programs
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// push constants come from the shaders, render systems with the same interface end up with the same layout
+		pipelineLayout = reflection.acquirePipelineLayout(device, descriptorSetLayouts);
 	}
 
 
 
 
 
-	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
+	void SimpleRenderSystem::createPipeline(const VTAShaderReflection& reflection, const char* fragShader, const RenderTargetInfo& renderTarget, const ShaderVariant& variant)
 	{
 
 		assert(pipelineLayout != nullptr && "Pipeline layout must be created before creating the pipeline.");
@@ -67,56 +103,175 @@ namespace VTA
 
 		PipelineConfigInfo pipelineConfig{};
 		VTAPipeline::defaultPipelineConfigInfo(pipelineConfig, device.msaaSamples);
-		pipelineConfig.renderPass = renderPass;
+		reflection.trimVertexInputs(pipelineConfig); // attributes the vertex shader never reads aren't fetched
+		VTAPipeline::setRenderTarget(pipelineConfig, renderTarget);
+		VTAPipeline::useDynamicRenderState(pipelineConfig, device, renderState);
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		pipeline = std::make_unique<VTAPipeline>(device, "simple_shader.vert.spv", "simple_shader.frag.spv", pipelineConfig);
+		assert(variant.maxLights <= MAX_LIGHTS && "The ubo only has room for MAX_LIGHTS lights");
+		pipelineConfig.specialization
+			.set(SpecializationId::MaxLights, variant.maxLights)
+			.set(SpecializationId::TextureSampling, variant.textureSampling)
+			.set(SpecializationId::LightingModel, static_cast<uint32_t>(variant.lightingModel));
+		pipeline = pipelineCompiler.compile(VERT_SHADER, fragShader, pipelineConfig);
+	}
+
+
+
+
+	uint32_t SimpleRenderSystem::meshId(const VTAModel& model)
+	{
+		// stable for as long as the system lives, so the keys of unchanged objects don't change between frames
+		auto [id, inserted] = meshIds.try_emplace(&model, static_cast<uint32_t>(meshIds.size()));
+		return id->second;
+	}
+
+	bool SimpleRenderSystem::drawsModel(const VTAModel& model) const
+	{
+		if (bindlessTextures) return true; // every texture is in the array
+		return model.inAtlas == (textureAtlas != nullptr);
 	}
 
+	VTABuffer& SimpleRenderSystem::reserveInstances(int frameIndex, uint32_t instanceCount, VTADescriptorCache* descriptorCache)
+	{
+		// beginFrame waited on this frame's fence, its old buffer can go
+		auto& buffer = instanceBuffers[frameIndex];
+		if (!buffer || buffer->getInstanceCount() < instanceCount)
+		{
+			uint32_t capacity = 64;
+			while (capacity < instanceCount) capacity *= 2;
 
+			if (buffer && descriptorCache) descriptorCache->invalidate(buffer->getBuffer());
 
+			buffer = std::make_unique<VTABuffer>(device, sizeof(InstanceData), capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			buffer->map();
+		}
+		return *buffer;
+	}
 
 	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo)
 	{
-		pipeline->bind(frameInfo.commandBuffer); // bind the pipeline to the command buffer
+		assert((frameInfo.descriptorCache || frameInfo.frameDescriptors) && "The instance set comes from the cache or the frame's descriptors");
+
+		// one key per object. Sorted, the instances of a model end up next to each other, models with the same texture
+		// next to each other, and each model's instances front to back. There's one pass and one pipeline here
+		glm::mat4 viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+		std::vector<const VTAGameObject*> objects;
+		objects.reserve(frameInfo.gameObjects.size());
+		drawList.clear();
+		for (auto& kv : frameInfo.gameObjects)
+		{
+			const VTAGameObject& obj = kv.second;
+			if (obj.model == nullptr || !drawsModel(*obj.model)) continue;
+
+			glm::vec4 clip = viewProjection * glm::vec4(obj.transform.translation, 1.f);
+			float depth = clip.w > 0.f ? clip.z / clip.w : 0.f;
+			uint64_t key = DrawKey::make(0, 0, static_cast<uint32_t>(obj.model->textureDSindex), meshId(*obj.model), depth);
+			drawList.add(key, static_cast<uint32_t>(objects.size()));
+			objects.push_back(&obj);
+		}
+		if (objects.empty()) return;
+		drawList.sort();
+
+		// runs of the same state become one instanced draw each
+		uint32_t instanceCount = static_cast<uint32_t>(objects.size());
+		VTABuffer& instanceBuffer = reserveInstances(frameInfo.frameIndex, instanceCount, frameInfo.descriptorCache);
+		auto* instances = static_cast<InstanceData*>(instanceBuffer.getMappedMemory());
+		std::vector<InstanceGroup> groups;
+		const auto& items = drawList.getItems();
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const VTAGameObject& obj = *objects[items[i].index];
+			if (i == 0 || DrawKey::state(items[i].key) != DrawKey::state(items[i - 1].key))
+			{
+				groups.push_back(InstanceGroup{ obj.model.get(), i, 0 });
+			}
+			groups.back().instanceCount++;
+			instances[i].modelMatrix = obj.transform.mat4();
+			instances[i].normalMatrix = obj.transform.normalMatrix();
+		}
+		instanceBuffer.flush();
+
+		// the whole buffer, so the cached set stays the same until reserveInstances replaces the buffer and invalidates it.
+		// Without a cache the set only lives for this frame
+		VkDescriptorSet instanceSet;
+		VkDescriptorBufferInfo instanceInfo = instanceBuffer.descriptorInfo();
+		if (frameInfo.descriptorCache)
+		{
+			instanceSet = frameInfo.descriptorCache->get(VTADescriptorCache::Request{ *instanceSetLayout }.buffer(0, instanceInfo));
+		}
+		else
+		{
+			instanceSet = frameInfo.frameDescriptors->allocate(instanceSetLayout->getDescriptorSetLayout());
+			VTADescriptorWriter{ *instanceSetLayout }
+				.writeBuffer(0, &instanceInfo)
+				.overwrite(instanceSet, device);
+		}
+
+		if (frameInfo.parallelRecorder)
+		{
+			frameInfo.parallelRecorder->record(frameInfo.commandBuffer, static_cast<uint32_t>(groups.size()),
+				[&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) { recordGroups(commandBuffer, frameInfo, groups, instanceSet, begin, end); });
+			return;
+		}
+		recordGroups(frameInfo.commandBuffer, frameInfo, groups, instanceSet, 0, static_cast<uint32_t>(groups.size()));
+	}
+
+	void SimpleRenderSystem::recordGroups(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, const std::vector<InstanceGroup>& groups,
+		VkDescriptorSet instanceSet, uint32_t begin, uint32_t end)
+	{
+		if (!pipeline.bind(commandBuffer)) return; // still compiling, nothing to draw with yet
+		VTAPipeline::setDynamicRenderState(commandBuffer, device, renderState);
 		
 		vkCmdBindDescriptorSets
-		(frameInfo.commandBuffer,
+		(commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
 			0, 1,
 			&frameInfo.descriptorSets[0],
 			0,
 			nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &instanceSet, 0, nullptr);
 
-
-		for (auto& kv : frameInfo.gameObjects)
+		if (bindlessTextures)
 		{
-			auto& obj = kv.second;
+			bindlessTextures->bind(commandBuffer, pipelineLayout, 1); // bound once, every texture is reachable through it
+		}
+		else if (textureAtlas)
+		{
+			textureAtlas->bind(commandBuffer, pipelineLayout, 1); // same here, draws only differ in push constants
+		}
 
-			if (obj.model == nullptr) continue;
+		int pushedTexture = -1; // groups come sorted by texture, it only changes between runs of them
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const InstanceGroup& group = groups[i];
 			
-			vkCmdBindDescriptorSets
-			(frameInfo.commandBuffer,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				1, 1,
-				&frameInfo.descriptorSets[obj.model->textureDSindex],
-				0,
-				nullptr);
-
-			SimplePushConstantsData push{};
-			auto modelMatrix = obj.transform.mat4();
-			push.modelMatrix = modelMatrix; // use the transform from the game object
-			push.normalMatrix = obj.transform.normalMatrix(); // also send the model matrix to the shader
-
-			vkCmdPushConstants(frameInfo.commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantsData),
-				&push);
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer); // draw the model with the push constants set
+			if (perDrawTextureLayout && group.model->textureDSindex != pushedTexture)
+			{
+				pushedTexture = group.model->textureDSindex;
+				VTADescriptorWriter{ *perDrawTextureLayout }
+					.writeImage(0, &group.model->textureInfo)
+					.push(commandBuffer, pipelineLayout, 1, frameInfo.frameDescriptors);
+			}
+
+			if (pushConstantSize > 0)
+			{
+				SimplePushConstantsData push{};
+				push.textureIndex = group.model->bindlessTextureIndex;
+				push.textureLayer = group.model->atlasRegion.layer;
+				push.uvScale = group.model->atlasRegion.uvScale;
+				push.uvOffset = group.model->atlasRegion.uvOffset;
+
+				vkCmdPushConstants(commandBuffer,
+					pipelineLayout,
+					pushConstantStages,
+					0,
+					pushConstantSize,
+					&push);
+			}
+			group.model->bind(commandBuffer);
+			group.model->draw(commandBuffer, group.instanceCount, group.firstInstance);
 		}
 
 	}
@@ -2,13 +2,22 @@
 
 
 #include "VTA_pipeline.h"
+#include "VTA_pipeline_compiler.h"
 #include "VTA_device.hpp"
 #include "VTA_model.h"
 #include "VTA_game_object.h"
 #include "VTA_camera.h"
 #include "VTA_frame_info.h"
+#include "VTA_bindless.h"
+#include "VTA_texture_atlas.h"
+#include "VTA_descriptors.h"
+#include "VTA_descriptor_cache.h"
+#include "VTA_buffer.h"
+#include "VTA_draw_list.h"
+#include "VTA_shader_reflection.h"
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace VTA
@@ -18,7 +27,25 @@ namespace VTA
 	public:
 
 
-		SimpleRenderSystem(VTADevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout);
+		// baked into the pipeline as specialization constants, each combination compiles to its own variant
+		struct ShaderVariant
+		{
+			uint32_t maxLights = MAX_LIGHTS;
+			bool textureSampling = true;
+			LightingModel lightingModel = LightingModel::BlinnPhong;
+		};
+
+		// Objects that share a model are drawn as one instanced draw, their matrices go into a per frame instance
+		// buffer (set 2). The texture belongs to the model, so it is the same for every instance of a draw:
+		// with bindlessTextures set, set 1 is the bindless array and the texture is picked through push constants.
+		// with textureAtlas set, set 1 is the atlas and each draw pushes its layer and uv transform. Only models whose
+		// texture is in the atlas are drawn.
+		// with neither, every draw pushes its texture into set 1 (push descriptors, or a frame transient set without them).
+		// Only models whose texture isn't in the atlas are drawn, so an atlas system and this one can share a scene.
+		// Draws are sorted by texture, model and depth, on threadPool when there are enough of them
+		SimpleRenderSystem(VTADevice& device, VTAPipelineCompiler& pipelineCompiler, const RenderTargetInfo& renderTarget, VkDescriptorSetLayout globalSetLayout,
+			VTABindlessTextures* bindlessTextures = nullptr, VTA_Image::TextureAtlas* textureAtlas = nullptr, const ShaderVariant& variant = ShaderVariant{},
+			VTAThreadPool* threadPool = nullptr);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
@@ -28,15 +55,42 @@ namespace VTA
 
 	private:
 
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		// one instanced draw, its instances are [firstInstance, firstInstance + instanceCount) of the frame's instance buffer
+		struct InstanceGroup
+		{
+			VTAModel* model;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+
+		void createPipelineLayout(const VTAShaderReflection& reflection, VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout);
+		uint32_t meshId(const VTAModel& model);
+		bool drawsModel(const VTAModel& model) const;
+		// the frame's instance buffer with room for instanceCount instances, mapped. A buffer that gets replaced is
+		// invalidated in descriptorCache first
+		VTABuffer& reserveInstances(int frameIndex, uint32_t instanceCount, VTADescriptorCache* descriptorCache);
+		// draws groups[begin, end), binds everything itself so it works in a fresh secondary
+		void recordGroups(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, const std::vector<InstanceGroup>& groups,
+			VkDescriptorSet instanceSet, uint32_t begin, uint32_t end);
+		void createPipeline(const VTAShaderReflection& reflection, const char* fragShader, const RenderTargetInfo& renderTarget, const ShaderVariant& variant);
 
 
 
 
 		VTADevice& device;
+		VTABindlessTextures* bindlessTextures;
+		VTA_Image::TextureAtlas* textureAtlas;
+		std::unique_ptr<VTADescriptorSetLayout> perDrawTextureLayout; // only in neither mode
+		std::unique_ptr<VTADescriptorSetLayout> instanceSetLayout;
+		std::vector<std::unique_ptr<VTABuffer>> instanceBuffers; // one per frame in flight, grown when a frame needs more
+		VTADrawList drawList;
+		std::unordered_map<const VTAModel*, uint32_t> meshIds; // the mesh field of the sort keys
 
-		std::unique_ptr<VTAPipeline> pipeline;
+		VTAPipelineCompiler& pipelineCompiler;
+		VTAPipelineCompiler::Handle pipeline; // draws are skipped until the compiler has something to bind
+		DynamicRenderState renderState; // set after every bind, the pipeline only holds it where the device can't
 		VkPipelineLayout pipelineLayout;
+		uint32_t pushConstantSize;
+		VkShaderStageFlags pushConstantStages; // the stages whose shaders declare the block
 	};
 }
\ No newline at end of file
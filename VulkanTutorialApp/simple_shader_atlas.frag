@@ -0,0 +1,113 @@
+#version 450
+// Atlas fragment shader of SimpleRenderSystem. The texture is a rectangle of one TextureAtlas layer, the draw pushes
+// the layer and the rectangle's uv transform. The push block is the same as simple_shader_bindless.frag's.
+//
+// glslc simple_shader_atlas.frag -o simple_shader_atlas.frag.spv
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+struct PointLight
+{
+	vec4 position; // ignore w
+	vec4 color;    // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	PointLight pointLights[100];
+	int numLights;
+} ubo;
+
+// SpecializationId in VTA_frame_info.h, SimpleRenderSystem::ShaderVariant picks the values
+layout(constant_id = 0) const uint MAX_LIGHTS = 100; // the loop's bound, so the driver can unroll it
+layout(constant_id = 1) const bool TEXTURE_SAMPLING = true;
+layout(constant_id = 2) const uint LIGHTING_MODEL = 0; // LightingModel: 0 Blinn-Phong, 1 Lambert, 2 unlit
+
+layout(set = 1, binding = 0) uniform sampler2DArray atlas;
+
+// SimplePushConstantsData
+layout(push_constant) uniform Push
+{
+	uint textureIndex; // bindless only
+	uint textureLayer;
+	vec2 uvScale;
+	vec2 uvOffset;
+} push;
+
+void main()
+{
+	vec3 textureColor = vec3(1.0);
+	if (TEXTURE_SAMPLING)
+	{
+		// repeat inside the texture's rectangle. The gradients are those of the unwrapped uv, fract's jumps would
+		// otherwise pick the smallest level along every seam
+		vec2 gradX = dFdx(fragUv) * push.uvScale;
+		vec2 gradY = dFdy(fragUv) * push.uvScale;
+		vec2 atlasUv = fract(fragUv) * push.uvScale + push.uvOffset;
+
+		// half a texel of the coarser level the lookup blends in, so bilinear taps stay inside the rectangle. Layers
+		// are square, the level follows from the same gradients the lookup uses
+		float atlasSize = float(textureSize(atlas, 0).x);
+		float lod = max(log2(max(length(gradX), length(gradY)) * atlasSize), 0.0);
+
+		// past the level where the texture's power of two block is 1x1 a texel covers neighbouring blocks. Shorter
+		// gradients keep the lookup at that level, anisotropic filtering only ever picks a finer one
+		float maxLod = ceil(log2(max(push.uvScale.x, push.uvScale.y) * atlasSize));
+		if (lod > maxLod)
+		{
+			float shrink = exp2(maxLod - lod);
+			gradX *= shrink;
+			gradY *= shrink;
+			lod = maxLod;
+		}
+		vec2 halfTexel = min(vec2(0.5 * exp2(ceil(lod)) / atlasSize), 0.5 * push.uvScale);
+		atlasUv = clamp(atlasUv, push.uvOffset + halfTexel, push.uvOffset + push.uvScale - halfTexel);
+
+		textureColor = textureGrad(atlas, vec3(atlasUv, float(push.textureLayer)), gradX, gradY).rgb;
+	}
+
+	if (LIGHTING_MODEL == 2u)
+	{
+		outColor = vec4(textureColor * fragColor, 1.0);
+		return;
+	}
+
+	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 specularLight = vec3(0.0);
+	vec3 surfaceNormal = normalize(fragNormalWorld);
+
+	vec3 cameraPosWorld = ubo.invView[3].xyz;
+	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+	for (uint i = 0u; i < MAX_LIGHTS; i++)
+	{
+		if (i >= uint(ubo.numLights)) break;
+
+		PointLight light = ubo.pointLights[i];
+		vec3 directionToLight = light.position.xyz - fragPosWorld;
+		float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
+		directionToLight = normalize(directionToLight);
+
+		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
+		vec3 intensity = light.color.xyz * light.color.w * attenuation;
+		diffuseLight += intensity * cosAngIncidence;
+
+		if (LIGHTING_MODEL == 0u)
+		{
+			vec3 halfAngle = normalize(directionToLight + viewDirection);
+			float blinnTerm = pow(clamp(dot(surfaceNormal, halfAngle), 0, 1), 512.0);
+			specularLight += intensity * blinnTerm;
+		}
+	}
+
+	outColor = vec4((diffuseLight + specularLight) * textureColor * fragColor, 1.0);
+}
@@ -0,0 +1,53 @@
+#version 450
+// Vertex shader of SimpleRenderSystem. Objects that share a model are drawn as one instanced draw, each instance's
+// matrices come from the frame's instance buffer at gl_InstanceIndex. Outputs match simple_shader.vert, so every
+// simple_shader fragment variant works with it, they still get the group's texture through push constants.
+//
+// glslc simple_shader_instanced.vert -o simple_shader_instanced.vert.spv
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+
+struct PointLight
+{
+	vec4 position; // ignore w
+	vec4 color;    // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	PointLight pointLights[100];
+	int numLights;
+} ubo;
+
+struct InstanceData
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Instances { InstanceData instances[]; };
+
+void main()
+{
+	InstanceData instance = instances[gl_InstanceIndex];
+
+	vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+
+	fragNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	fragColor = color;
+	fragUv = uv;
+}